@@ -0,0 +1,275 @@
+/* acct.c - per-process CPU accounting and the procstat virtual file
+ * vim:ts=4 noexpandtab
+ */
+
+/* Time is charged with the TSC at every change of who's running or which mode they're in:
+ * syscall entry and return, interrupt and exception entry and return, and context switches.
+ * Whatever ran since the last charge gets the cycles, as user or kernel time. Time spent idle
+ * (the scheduler halted with nothing ready) belongs to nobody.
+ */
+
+#include "acct.h"
+#include "system_calls.h"
+#include "scheduler.h"
+#include "pit.h"
+#include "lib.h"
+#include "x86_desc.h"
+#include "process.h"
+
+#define PROCSTAT_BUF_SIZE 65536
+#define PROCSTAT_NUM_LEN 11     // longest 32-bit number plus its terminator
+
+// TSC at the last charge, and whether the running process has been in user mode since
+static uint64_t acct_stamp = 0;
+static uint32_t acct_in_user = 0;
+
+// procstat is rendered here on every read
+static int8_t procstat_buf[PROCSTAT_BUF_SIZE];
+
+/*
+ * acct_init
+ *    DESCRIPTION: Zeroes a process's counters
+ *    INPUTS: acct -- accounting of the new process
+ *    RETURNS: none
+ */
+void acct_init(proc_acct_t* acct) {
+    memset(acct, 0, sizeof(proc_acct_t));
+}
+
+/*
+ * acct_charge
+ *    DESCRIPTION: Gives the cycles since the last charge to the running process
+ *    INPUTS: none
+ *    RETURNS: none
+ *    NOTES: Call with interrupts off
+ */
+void acct_charge(void) {
+    uint64_t now = rdtsc();
+
+    if(current_pcb != NULL && !sched_in_idle) {
+        if(acct_in_user)
+            current_pcb->acct.user_cycles += now - acct_stamp;
+        else
+            current_pcb->acct.kernel_cycles += now - acct_stamp;
+    }
+    acct_stamp = now;
+}
+
+/*
+ * acct_skip
+ *    DESCRIPTION: Starts counting from now without charging anyone for the time since the last charge
+ *    INPUTS: none
+ *    RETURNS: none
+ */
+void acct_skip(void) {
+    acct_stamp = rdtsc();
+}
+
+/*
+ * acct_syscall_enter
+ *    DESCRIPTION: Ends the user time before a syscall and starts timing the syscall
+ *    INPUTS: none
+ *    RETURNS: none
+ *    NOTES: systems_handler calls this with interrupts off once current_syscall is set
+ */
+void acct_syscall_enter(void) {
+    uint32_t slot = current_syscall < ACCT_SYSCALL_SLOTS ? current_syscall : 0;
+
+    acct_charge();
+    acct_in_user = 0;
+    if(current_pcb == NULL)
+        return;
+
+    current_pcb->acct.syscall = slot;
+    current_pcb->acct.syscall_start = acct_stamp;
+    current_pcb->acct.syscall_counts[slot]++;
+}
+
+/*
+ * acct_syscall_exit
+ *    DESCRIPTION: Ends the kernel time of a syscall and adds up how long it took
+ *    INPUTS: none
+ *    RETURNS: none
+ *    NOTES: Goes by the PCB rather than current_syscall, a parent returning from execute
+ *           gets there through halt
+ */
+void acct_syscall_exit(void) {
+    acct_charge();
+    acct_in_user = 1;
+    if(current_pcb == NULL || current_pcb->acct.syscall == 0)
+        return;
+
+    current_pcb->acct.syscall_cycles[current_pcb->acct.syscall] += acct_stamp - current_pcb->acct.syscall_start;
+    current_pcb->acct.syscall = 0;
+}
+
+/*
+ * acct_irq_enter
+ *    DESCRIPTION: Charges what ran up to an interrupt or exception, which is kernel time from here
+ *    INPUTS: none
+ *    RETURNS: Whether the interrupted code was in user mode, for acct_irq_exit
+ */
+uint32_t acct_irq_enter(void) {
+    uint32_t was_user = acct_in_user;
+
+    acct_charge();
+    acct_in_user = 0;
+    return was_user;
+}
+
+/*
+ * acct_irq_exit
+ *    DESCRIPTION: Charges the handler as kernel time and goes back to the interrupted mode
+ *    INPUTS: was_user -- what acct_irq_enter returned
+ *    RETURNS: none
+ *    NOTES: If the handler switched processes, this runs once the interrupted one is back
+ */
+void acct_irq_exit(uint32_t was_user) {
+    acct_charge();
+    acct_in_user = was_user;
+}
+
+/*
+ * acct_enter_user
+ *    DESCRIPTION: Switches the running process's charges to user time
+ *    INPUTS: none
+ *    RETURNS: none
+ *    NOTES: For execute, which starts the new program with an iret of its own
+ */
+void acct_enter_user(void) {
+    acct_charge();
+    acct_in_user = 1;
+}
+
+/*
+ * procstat_put
+ *    DESCRIPTION: Appends a string to the procstat text, dropping what doesn't fit
+ *    INPUTS: len -- bytes of text so far
+ *            s -- string to add
+ *    RETURNS: The new length
+ */
+static uint32_t procstat_put(uint32_t len, const int8_t* s) {
+    while(*s != '\0' && len < PROCSTAT_BUF_SIZE)
+        procstat_buf[len++] = *s++;
+    return len;
+}
+
+/*
+ * procstat_put_num
+ *    DESCRIPTION: Appends a decimal number and a separator to the procstat text
+ *    INPUTS: len -- bytes of text so far
+ *            value -- number to add
+ *            sep -- string to put after it
+ *    RETURNS: The new length
+ */
+static uint32_t procstat_put_num(uint32_t len, uint32_t value, const int8_t* sep) {
+    int8_t num[PROCSTAT_NUM_LEN];
+
+    len = procstat_put(len, itoa(value, num, 10));
+    return procstat_put(len, sep);
+}
+
+/*
+ * procstat_render
+ *    DESCRIPTION: Writes the current stats of every process into procstat_buf
+ *    INPUTS: none
+ *    RETURNS: Length of the text
+ *    NOTES: Cycle counts are in units of 1024 cycles (kc) so they fit in 32 bits.
+ *           Per process: pid, terminal (1-3), state, nice, user kc, kernel kc, switches,
+ *           then number:calls:kc for every syscall it has made
+ */
+static uint32_t procstat_render(void) {
+    static const int8_t state_chars[] = "RRSZ";    // ready, running, blocked, zombie
+    int8_t state[2] = {0, 0};
+    uint32_t len = 0;
+    uint32_t pid, i;
+
+    len = procstat_put(len, "tsc_khz ");
+    len = procstat_put_num(len, tsc_khz, "\n");
+    len = procstat_put(len, "pid tty state nice user_kc kernel_kc switches syscall:calls:kc...\n");
+
+    for(pid = 0; pid < MAX_PIDS; pid++) {
+        pcb_t * pcb = pid_to_pcb(pid);
+        if(pcb == NULL)
+            continue;
+
+        state[0] = pcb->state <= PROC_ZOMBIE ? state_chars[pcb->state] : '?';
+        len = procstat_put_num(len, pid, " ");
+        len = procstat_put_num(len, pcb->terminal_id + 1, " ");
+        len = procstat_put(len, state);
+        len = procstat_put(len, " ");
+        len = procstat_put_num(len, pcb->nice, " ");
+        len = procstat_put_num(len, (uint32_t)(pcb->acct.user_cycles >> 10), " ");
+        len = procstat_put_num(len, (uint32_t)(pcb->acct.kernel_cycles >> 10), " ");
+        len = procstat_put_num(len, pcb->acct.switches, "");
+        for(i = 1; i < ACCT_SYSCALL_SLOTS; i++) {
+            if(pcb->acct.syscall_counts[i] == 0)
+                continue;
+            len = procstat_put(len, " ");
+            len = procstat_put_num(len, i, ":");
+            len = procstat_put_num(len, pcb->acct.syscall_counts[i], ":");
+            len = procstat_put_num(len, (uint32_t)(pcb->acct.syscall_cycles[i] >> 10), "");
+        }
+        len = procstat_put(len, "\n");
+    }
+    return len;
+}
+
+/*
+ * procstat_read
+ *    DESCRIPTION: Reads the stats text from the file position on
+ *    INPUTS: fd -- file descriptor
+ *            buf -- output buffer
+ *            nbytes -- most bytes to read
+ *    RETURNS: Bytes read, 0 at the end of the text
+ *    NOTES: The text is rendered fresh on every read, so read it in one go for a consistent snapshot
+ */
+int32_t procstat_read(int32_t fd, void* buf, int32_t nbytes) {
+    file_descriptor_t * file = &current_pcb->fda[fd];
+    uint32_t flags, len;
+
+    if(nbytes < 0)
+        return -1;
+
+    cli_and_save(flags);
+    acct_charge();      // bring the reader's own numbers up to date
+    len = procstat_render();
+    if(file->file_pos >= len) {
+        restore_flags(flags);
+        return 0;
+    }
+    if((uint32_t)nbytes > len - file->file_pos)
+        nbytes = len - file->file_pos;
+    memcpy(buf, procstat_buf + file->file_pos, nbytes);
+    file->file_pos += nbytes;
+    restore_flags(flags);
+
+    return nbytes;
+}
+
+/*
+ * procstat_write
+ *    DESCRIPTION: Does nothing, procstat is read-only
+ *    RETURNS: Always -1
+ */
+int32_t procstat_write(int32_t fd, const void* buf, int32_t nbytes) {
+    return -1;
+}
+
+/*
+ * procstat_open
+ *    DESCRIPTION: Nothing to set up, the text is rendered when it's read
+ *    RETURNS: Always 0
+ */
+int32_t procstat_open(const uint8_t* filename) {
+    return 0;
+}
+
+/*
+ * procstat_close
+ *    DESCRIPTION: Nothing to clean up
+ *    RETURNS: Always 0
+ */
+int32_t procstat_close(int32_t fd) {
+    return 0;
+}
@@ -0,0 +1,53 @@
+/* acct.h - per-process CPU accounting and the procstat virtual file
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _ACCT_H
+#define _ACCT_H
+
+#include "types.h"
+
+// Syscall numbers below this get their own counters
+#define ACCT_SYSCALL_SLOTS 32
+
+// Name open() serves the stats from, there's no dentry behind it
+#define PROCSTAT_NAME "procstat"
+
+// Where a process's time went, kept in its PCB
+typedef struct proc_acct {
+    uint64_t user_cycles;               // TSC cycles spent in user mode
+    uint64_t kernel_cycles;             // TSC cycles spent in syscalls, interrupts and exceptions
+    uint32_t switches;                  // times the scheduler switched the process out
+    uint32_t syscall;                   // syscall in progress, 0 if none
+    uint64_t syscall_start;             // TSC when that syscall was entered
+    uint32_t syscall_counts[ACCT_SYSCALL_SLOTS];    // calls made, by syscall number
+    uint64_t syscall_cycles[ACCT_SYSCALL_SLOTS];    // entry to return, blocked time included
+} proc_acct_t;
+
+// Empties the accounting of a new process
+extern void acct_init(proc_acct_t* acct);
+
+// Charges the cycles since the last charge to the running process
+extern void acct_charge(void);
+
+// Drops the cycles since the last charge (time nobody was running)
+extern void acct_skip(void);
+
+// Called from systems_handler around each syscall
+extern void acct_syscall_enter(void);
+extern void acct_syscall_exit(void);
+
+// Called from interrupt and exception entry points, exit takes what enter returned
+extern uint32_t acct_irq_enter(void);
+extern void acct_irq_exit(uint32_t was_user);
+
+// The running process is about to drop to user mode without a syscall return (a new program)
+extern void acct_enter_user(void);
+
+// fops for the procstat file
+extern int32_t procstat_read(int32_t fd, void* buf, int32_t nbytes);
+extern int32_t procstat_write(int32_t fd, const void* buf, int32_t nbytes);
+extern int32_t procstat_open(const uint8_t* filename);
+extern int32_t procstat_close(int32_t fd);
+
+#endif /* _ACCT_H */
@@ -1,6 +1,9 @@
 #ifndef _ASM_LINKAGE_H
 #define _ASM_LINKAGE_H
 
+// Offset of esp0 in the TSS, sysenter_handler reads the kernel stack from there
+#define TSS_ESP0 4
+
 #ifndef ASM
 
 #include "idt.h"
@@ -35,6 +38,13 @@ extern void keyboard_processor();   //process keyboard interrupt
 extern void RTC_processor();        //process RTC interrupt
 extern void PIT_processor();
 extern void systems_handler();      //process systems call arg
+extern void sysenter_handler();     //process system call made with sysenter
+
+// Saves the callee-saved registers and esp into *save_esp, then resumes the stack at next_esp
+extern void context_switch(uint32_t* save_esp, uint32_t next_esp);
+
+// Where a forked child starts, returns 0 from fork to user space through systems_handler's frame
+extern void fork_child_return();
 
 #endif /* ASM */
 #endif /* _ASM_LINKAGE_H */
@@ -2,6 +2,13 @@
 #include "lib.h"
 #include "system_calls.h"
 #include "x86_desc.h"
+#include "scheduler.h"
+
+#define FNV_OFFSET_BASIS 2166136261u    //32-bit FNV-1a parameters
+#define FNV_PRIME 16777619u
+
+/*open-addressed hash index over boot->dentries, keyed by file name*/
+static dentry_hash_t dentry_index[DENTRY_HASH_SIZE];
 
 /*  
  * init_filesystem
@@ -9,6 +16,7 @@
  *    INPUTS: pointer to the start of the file system
  *    OUTPUTS: NONE
  *    SIDE EFFECTS: Boot, inode, dentry, and data block global variables are initialized
+ *                  and the dentry hash index is built
  *    NOTES: See Appendix A
  */ 
 void init_filesystem(uint32_t start){
@@ -16,6 +24,40 @@ void init_filesystem(uint32_t start){
     fs_inode=(inode_t*)(start+BLOCK_SIZE);   //inodes start one block (4KB) after start/boot
     fs_dentry=(dentry_t*)(start+64);   //dir entries start 64B after start/boot 
     fs_data_block=(data_block_t*)(start+BLOCK_SIZE*(boot->num_inodes+1)); //data block starts a block after inode
+
+    int i;
+    uint32_t hash, slot;
+    for(i=0;i<DENTRY_HASH_SIZE;i++)
+        dentry_index[i].dentry_i=DENTRY_HASH_EMPTY;
+
+    /*insert every dentry with linear probing, first entry wins if a name is duplicated*/
+    for(i=0;i<boot->num_dentries && i<MAX_DENTRY-1;i++){
+        hash=dentry_name_hash(boot->dentries[i].fname);
+        slot=hash & (DENTRY_HASH_SIZE-1);
+        while(dentry_index[slot].dentry_i!=DENTRY_HASH_EMPTY)
+            slot=(slot+1) & (DENTRY_HASH_SIZE-1);
+        dentry_index[slot].hash=hash;
+        dentry_index[slot].dentry_i=i;
+    }
+}
+
+/*  
+ * dentry_name_hash
+ *    DESCRIPTION: FNV-1a hash of a file name
+ *    INPUTS: fname -- name to hash
+ *    OUTPUTS: 32-bit hash
+ *    SIDE EFFECTS: none
+ *    NOTES: Stops at a NUL or after FNAME_LENGTH chars since dentry names fill all 32 bytes
+ *           without a terminator when they are exactly 32 chars long
+ */ 
+uint32_t dentry_name_hash(const uint8_t* fname){
+    uint32_t hash=FNV_OFFSET_BASIS;
+    int i;
+    for(i=0;i<FNAME_LENGTH && fname[i]!='\0';i++){
+        hash^=fname[i];
+        hash*=FNV_PRIME;
+    }
+    return hash;
 }
 
 /*  
@@ -24,24 +66,27 @@ void init_filesystem(uint32_t start){
  *    INPUTS: file name (to find), dentry (to copy over to)
  *    OUTPUTS: 0 for success, -1 for fail
  *    SIDE EFFECTS: Dentry block is initialized with info upon success
- *    NOTES: See Appendix A
+ *    NOTES: See Appendix A. Looks the name up in the hash index instead of scanning every dentry
  */ 
 int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry){
     if(fname==NULL||dentry==NULL||strlen((int8_t*)fname) > 32)   //check for invalid pointers
         return -1;
 
-    int i;
-    for(i=0;i<boot->num_dentries;i++){      //loop through all dentries
+    uint32_t hash=dentry_name_hash(fname);
+    uint32_t slot=hash & (DENTRY_HASH_SIZE-1);
+    int32_t i;
+
+    /*probe until an empty slot, the table is never full so this always terminates*/
+    while((i=dentry_index[slot].dentry_i)!=DENTRY_HASH_EMPTY){
         /*if names match, copy over dentry file name, type, and index node into dentry block*/
-        if(!strncmp((int8_t*)&(boot->dentries[i]),(int8_t*)fname,FNAME_LENGTH)){   
-            // if(strlen((int8_t*)fname) <= 32){
-                strncpy((int8_t*)dentry->fname, (int8_t*)boot->dentries[i].fname,FNAME_LENGTH);
-                dentry->ftype=boot->dentries[i].ftype;
-                dentry->inode=boot->dentries[i].inode;
-                return 0;   //successfully copied over, return 0
-            // }  
-            
+        if(dentry_index[slot].hash==hash &&
+           !strncmp((int8_t*)&(boot->dentries[i]),(int8_t*)fname,FNAME_LENGTH)){   
+            strncpy((int8_t*)dentry->fname, (int8_t*)boot->dentries[i].fname,FNAME_LENGTH);
+            dentry->ftype=boot->dentries[i].ftype;
+            dentry->inode=boot->dentries[i].inode;
+            return 0;   //successfully copied over, return 0
         }
+        slot=(slot+1) & (DENTRY_HASH_SIZE-1);
     }
     return -1;  //dentry not found, return -1 
 }
@@ -71,14 +116,16 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry){
 
 /*  
  * read_data
- *    DESCRIPTION: Finds and copies over dentry info into a dentry block based on given index
+ *    DESCRIPTION: Copies file data starting at offset into buf one data block span at a time
  *    INPUTS: inode -- file inode to read
  *            offset -- offset to start reading from
  *            buf -- output buffer to write file data to
  *            nbytes -- number of bytes to read from file
  *    OUTPUTS: number of bytes read
  *    SIDE EFFECTS: buf holds file data
- *    NOTES: See Appendix A
+ *    NOTES: See Appendix A. Each data block is looked up once and the run of bytes inside it
+ *           is moved with memcpy, so the cost is one index lookup per 4KB instead of per byte.
+ *           Reads are clamped so that they never go past the end of the file.
  */ 
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
     if(buf==NULL)           //check for invalid pointer
@@ -92,15 +139,32 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
     if(offset >= curr_inode->file_size) //check if offset from start of file is out of bounds
         return 0;
 
-    int bytes_read;
+    // Clamp length so the last byte read is the last byte of the file
+    if(length > curr_inode->file_size - offset)
+        length = curr_inode->file_size - offset;
+
+    uint32_t bytes_read = 0;
+    uint32_t block_i = offset / BLOCK_SIZE;         // index into the inode's data block list
+    uint32_t block_offset = offset % BLOCK_SIZE;    // starting byte within the first block
+    uint32_t span;                                  // bytes copied out of the current block
+    uint32_t data_block_num;
     data_block_t* curr_data_block;
 
-    for(bytes_read=0; bytes_read<length; bytes_read++){     //loop through bytes that need to be read
-        if((offset) > curr_inode->file_size)     //break if bytes read go out of file bounds
+    while(bytes_read < length){
+        data_block_num = curr_inode->index_num[block_i];
+        if(data_block_num >= boot->num_data_blocks)     //stop on a corrupt data block index
             break;
-        curr_data_block=(data_block_t*)(fs_data_block + (curr_inode->index_num[offset/BLOCK_SIZE])); //finds start of data block of which to read bytes from
-        buf[bytes_read]=curr_data_block->block[offset%BLOCK_SIZE];  //copy data into buf
-        offset++;
+        curr_data_block = &fs_data_block[data_block_num];
+
+        // Copy either the rest of this block or the rest of the request, whichever is smaller
+        span = BLOCK_SIZE - block_offset;
+        if(span > length - bytes_read)
+            span = length - bytes_read;
+        memcpy(buf + bytes_read, curr_data_block->block + block_offset, span);
+
+        bytes_read += span;
+        block_i++;
+        block_offset = 0;   //every block after the first is read from its start
     }
     return bytes_read;
 }
@@ -119,14 +183,15 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
  */
 int32_t read_file(int32_t fd, void* buf, int32_t nbytes){
     uint32_t inode, offset;
-    pcb_t* pcb=(pcb_t*)(tss.esp0  & 0xFFFFE000); //place holder until we figure out how to initialize pcb
+    pcb_t* pcb=current_pcb;
     
     offset=pcb->fda[fd].file_pos;
     inode=pcb->fda[fd].inode;
 
 
-    pcb->fda[fd].file_pos+=nbytes;  //update file position for next file
-    return read_data(inode, offset, (uint8_t*)buf, nbytes);
+    int32_t bytes_read = read_data(inode, offset, (uint8_t*)buf, nbytes);
+    pcb->fda[fd].file_pos+=bytes_read;  //advance by what was actually read so EOF stays sticky
+    return bytes_read;
 }
 
 /*  
@@ -176,7 +241,7 @@ int32_t close_file (int32_t fd){
  *    NOTES: See Appendix A
  */
 int32_t read_dir(int32_t fd, void* buf, int32_t nbytes){
-    pcb_t* pcb=(pcb_t*)(tss.esp0  & 0xFFFFE000); //place holder until we figure out how to initialize pcb
+    pcb_t* pcb=current_pcb;
     
     dentry_t dentry;
     uint32_t position;
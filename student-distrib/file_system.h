@@ -6,6 +6,8 @@
 #define BLOCK_SIZE 4096         //file system memory is divided into 4KB blocks
 #define FNAME_LENGTH  32        //file name limit is 32 characters 
 #define MAX_DENTRY 64
+#define DENTRY_HASH_SIZE 128    //power of two at least twice MAX_DENTRY so probe chains stay short
+#define DENTRY_HASH_EMPTY -1    //marks an unused slot in the dentry hash index
 
 typedef struct{ 
     uint8_t block[BLOCK_SIZE];    
@@ -33,6 +35,12 @@ typedef struct{
 }boot_block_t;
 
 
+/*one slot of the dentry hash index built by init_filesystem*/
+typedef struct{
+    uint32_t hash;              //full hash of the name so most mismatches skip the string compare
+    int32_t dentry_i;           //index into boot->dentries, DENTRY_HASH_EMPTY if slot is unused
+}dentry_hash_t;
+
 /*global variables that will keep track of entire file system structure*/
 data_block_t* fs_data_block;
 inode_t* fs_inode;
@@ -42,6 +50,9 @@ dentry_t* fs_dentry;
 //initializes filesystem based off start pointer
 extern void init_filesystem(uint32_t start);
 
+//hashes a (not necessarily NUL-terminated) file name of up to FNAME_LENGTH chars
+extern uint32_t dentry_name_hash(const uint8_t* fname);
+
 /*these file system functions are specified in Appendix A*/
 extern int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry);
 extern int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry);
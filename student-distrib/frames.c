@@ -0,0 +1,282 @@
+/* frames.c - Allocator for 4KB and 4MB physical page frames
+ * vim:ts=4 noexpandtab
+ */
+
+/* The pool is a bitmap with one bit per 4KB frame, set while the frame is free, plus a count of
+ * free frames in every 4MB chunk. Only RAM the bootloader reports as usable ever gets a bit set,
+ * so holes in the memory map and the boot modules are never handed out. 4KB allocations go to
+ * the fullest chunk that still has room, which keeps untouched chunks whole for 4MB allocations.
+ */
+
+#include "frames.h"
+#include "paging.h"
+#include "lib.h"
+
+#define BITMAP_WORD_BITS 32
+#define WORDS_PER_LARGE (FRAMES_PER_LARGE / BITMAP_WORD_BITS)
+
+// One bit per pool frame, set while the frame is free
+static uint32_t free_bitmap[NUM_POOL_FRAMES / BITMAP_WORD_BITS];
+
+// Free frames in each 4MB chunk of the pool, and whether the chunk went out whole
+static uint16_t chunk_free[NUM_POOL_LARGE];
+static uint8_t chunk_large[NUM_POOL_LARGE];
+
+// Number of page table entries referencing each pool frame (copy-on-write sharing)
+static uint16_t frame_refs[NUM_POOL_FRAMES];
+
+/*
+ * frame_index
+ *    DESCRIPTION: Converts a physical address to its pool-relative frame number
+ *    INPUTS: addr -- physical address inside the frame
+ *    RETURNS: frame number, or -1 if the address isn't in the pool
+ */
+static int32_t frame_index(uint32_t addr) {
+    if(addr < FRAME_POOL_START || addr >= FRAME_POOL_END)
+        return -1;
+    return (addr - FRAME_POOL_START) >> 12;
+}
+
+/*
+ * frames_set_free
+ *    DESCRIPTION: Marks the pool frames in a physical range free or reserved
+ *    INPUTS: start -- first byte of the range
+ *            end -- one past the last byte of the range
+ *            free -- 1 to make the frames available, 0 to take them out of the pool
+ *    RETURNS: none
+ *    NOTES: Freeing only takes frames that lie wholly inside the range, reserving takes every
+ *           frame the range touches. The range is clipped to the pool.
+ */
+static void frames_set_free(uint32_t start, uint32_t end, uint32_t free) {
+    uint32_t frame, last, mask;
+
+    if(start < FRAME_POOL_START)
+        start = FRAME_POOL_START;
+    if(end > FRAME_POOL_END)
+        end = FRAME_POOL_END;
+    if(start >= end)
+        return;
+
+    if(free) {
+        frame = (start - FRAME_POOL_START + FOUR_KB - 1) >> 12;
+        last = (end - FRAME_POOL_START) >> 12;
+    }
+    else {
+        frame = (start - FRAME_POOL_START) >> 12;
+        last = (end - FRAME_POOL_START + FOUR_KB - 1) >> 12;
+    }
+
+    for(; frame < last; frame++) {
+        mask = 1 << (frame % BITMAP_WORD_BITS);
+        if(free && !(free_bitmap[frame / BITMAP_WORD_BITS] & mask)) {
+            free_bitmap[frame / BITMAP_WORD_BITS] |= mask;
+            chunk_free[frame / FRAMES_PER_LARGE]++;
+            frame_stats.free_frames++;
+            frame_stats.total_frames++;
+        }
+        else if(!free && (free_bitmap[frame / BITMAP_WORD_BITS] & mask)) {
+            free_bitmap[frame / BITMAP_WORD_BITS] &= ~mask;
+            chunk_free[frame / FRAMES_PER_LARGE]--;
+            frame_stats.free_frames--;
+            frame_stats.total_frames--;
+        }
+    }
+}
+
+/*
+ * frames_add_multiboot
+ *    DESCRIPTION: Fills the pool from the memory map the bootloader passed in
+ *    INPUTS: mbi -- multiboot information structure
+ *    RETURNS: none
+ *    SIDE EFFECTS: Every available region of the memory map (or the mem_upper range if there is no
+ *                  map) becomes free, then the frames under the boot modules are taken back out
+ *    NOTES: Must run before init_paging(), the bootloader's tables are only reachable until then
+ */
+void frames_add_multiboot(multiboot_info_t* mbi) {
+    memory_map_t *mmap;
+    module_t *mod;
+    uint32_t i, end;
+
+    if(mbi->flags & MULTIBOOT_INFO_MMAP) {
+        for(mmap = (memory_map_t *)mbi->mmap_addr;
+                (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+                mmap = (memory_map_t *)((uint32_t)mmap + mmap->size + sizeof(mmap->size))) {
+            if(mmap->type != MULTIBOOT_MMAP_AVAILABLE || mmap->base_addr_high != 0)
+                continue;
+            end = mmap->base_addr_low + mmap->length_low;
+            if(mmap->length_high != 0 || end < mmap->base_addr_low)
+                end = FRAME_POOL_END;       // region runs past 4GB
+            frames_set_free(mmap->base_addr_low, end, 1);
+        }
+    }
+    else if(mbi->flags & MULTIBOOT_INFO_MEMORY) {
+        if(mbi->mem_upper >= (FRAME_POOL_END - MULTIBOOT_UPPER_MEM_BASE) / ONE_KB)
+            end = FRAME_POOL_END;
+        else
+            end = MULTIBOOT_UPPER_MEM_BASE + mbi->mem_upper * ONE_KB;
+        frames_set_free(MULTIBOOT_UPPER_MEM_BASE, end, 1);
+    }
+
+    if(mbi->flags & MULTIBOOT_INFO_MODS) {
+        mod = (module_t *)mbi->mods_addr;
+        for(i = 0; i < mbi->mods_count; i++, mod++)
+            frames_set_free(mod->mod_start, mod->mod_end, 0);
+    }
+}
+
+/*
+ * init_frames
+ *    DESCRIPTION: Identity maps every 4MB of the pool that has usable frames for the kernel
+ *    INPUTS/OUTPUTS: none
+ *    SIDE EFFECTS: Page directory entries covering the pool become kernel pages
+ *    NOTES: Must run after init_paging(). The kernel reaches any frame through its physical address.
+ *           If the bootloader reported no memory, the pool is 8MB up to FRAME_FALLBACK_END.
+ */
+void init_frames(void) {
+    uint32_t i;
+
+    if(frame_stats.total_frames == 0)
+        frames_set_free(FRAME_POOL_START, FRAME_FALLBACK_END, 1);
+
+    for(i = 0; i < NUM_POOL_LARGE; i++) {
+        if(chunk_free[i] != 0)
+            map_kernel_page(FRAME_POOL_START / FOUR_MB + i);
+    }
+
+    frame_stats.allocs = 0;
+    frame_stats.alloc_failures = 0;
+    frame_stats.large_allocs = 0;
+    frame_stats.large_failures = 0;
+}
+
+/*
+ * frame_alloc
+ *    DESCRIPTION: Allocates one 4KB frame
+ *    INPUTS: none
+ *    RETURNS: physical address of the frame, or 0 if the pool is empty
+ *    SIDE EFFECTS: The frame starts with a single reference, its contents are not cleared
+ *    NOTES: Takes the lowest free frame of the fullest chunk that isn't full
+ */
+uint32_t frame_alloc(void) {
+    uint32_t flags, i, word, frame;
+    int32_t best = -1;
+
+    cli_and_save(flags);
+    for(i = 0; i < NUM_POOL_LARGE; i++) {
+        if(chunk_free[i] != 0 && (best == -1 || chunk_free[i] < chunk_free[best]))
+            best = i;
+    }
+    if(best == -1) {
+        frame_stats.alloc_failures++;
+        restore_flags(flags);
+        return 0;
+    }
+
+    for(word = best * WORDS_PER_LARGE; free_bitmap[word] == 0; word++);
+    frame = word * BITMAP_WORD_BITS + __builtin_ctz(free_bitmap[word]);
+    free_bitmap[word] &= ~(1 << (frame % BITMAP_WORD_BITS));
+    chunk_free[best]--;
+    frame_refs[frame] = 1;
+    frame_stats.free_frames--;
+    frame_stats.allocs++;
+    restore_flags(flags);
+
+    return FRAME_POOL_START + (frame << 12);
+}
+
+/*
+ * frame_alloc_large
+ *    DESCRIPTION: Allocates a whole 4MB chunk of the pool
+ *    INPUTS: none
+ *    RETURNS: physical address of the chunk (4MB aligned), or 0 if no chunk is entirely free
+ *    SIDE EFFECTS: The chunk is not reference counted, frame_get()/frame_put() leave it alone
+ */
+uint32_t frame_alloc_large(void) {
+    uint32_t flags, i;
+
+    cli_and_save(flags);
+    for(i = 0; i < NUM_POOL_LARGE; i++) {
+        if(chunk_free[i] == FRAMES_PER_LARGE) {
+            memset(&free_bitmap[i * WORDS_PER_LARGE], 0, WORDS_PER_LARGE * sizeof(uint32_t));
+            chunk_free[i] = 0;
+            chunk_large[i] = 1;
+            frame_stats.free_frames -= FRAMES_PER_LARGE;
+            frame_stats.large_allocs++;
+            restore_flags(flags);
+            return FRAME_POOL_START + i * FOUR_MB;
+        }
+    }
+    frame_stats.large_failures++;
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ * frame_free_large
+ *    DESCRIPTION: Returns a chunk from frame_alloc_large() to the pool
+ *    INPUTS: addr -- physical address the chunk was allocated at
+ *    RETURNS: none
+ */
+void frame_free_large(uint32_t addr) {
+    uint32_t flags, chunk;
+
+    if(frame_index(addr) == -1 || (addr & (FOUR_MB - 1)) != 0)
+        return;
+    chunk = (addr - FRAME_POOL_START) / FOUR_MB;
+
+    cli_and_save(flags);
+    if(chunk_large[chunk]) {
+        memset(&free_bitmap[chunk * WORDS_PER_LARGE], 0xFF, WORDS_PER_LARGE * sizeof(uint32_t));
+        chunk_free[chunk] = FRAMES_PER_LARGE;
+        chunk_large[chunk] = 0;
+        frame_stats.free_frames += FRAMES_PER_LARGE;
+    }
+    restore_flags(flags);
+}
+
+/*
+ * frame_get
+ *    DESCRIPTION: Adds a reference to a frame that is about to be mapped somewhere else too
+ *    INPUTS: addr -- physical address of the frame
+ *    RETURNS: none
+ */
+void frame_get(uint32_t addr) {
+    int32_t frame = frame_index(addr);
+    if(frame == -1 || frame_refs[frame] == 0)
+        return;
+    frame_refs[frame]++;
+}
+
+/*
+ * frame_put
+ *    DESCRIPTION: Drops a reference to a frame, freeing it when nothing maps it anymore
+ *    INPUTS: addr -- physical address of the frame
+ *    RETURNS: none
+ */
+void frame_put(uint32_t addr) {
+    uint32_t flags;
+    int32_t frame = frame_index(addr);
+    if(frame == -1 || frame_refs[frame] == 0)
+        return;
+
+    cli_and_save(flags);
+    if(--frame_refs[frame] == 0) {
+        free_bitmap[frame / BITMAP_WORD_BITS] |= 1 << (frame % BITMAP_WORD_BITS);
+        chunk_free[frame / FRAMES_PER_LARGE]++;
+        frame_stats.free_frames++;
+    }
+    restore_flags(flags);
+}
+
+/*
+ * frame_refcount
+ *    DESCRIPTION: Reports how many mappings share a frame
+ *    INPUTS: addr -- physical address of the frame
+ *    RETURNS: reference count, 0 for large frames (e.g. the image cache) and frames outside the pool
+ */
+uint32_t frame_refcount(uint32_t addr) {
+    int32_t frame = frame_index(addr);
+    if(frame == -1)
+        return 0;
+    return frame_refs[frame];
+}
@@ -0,0 +1,66 @@
+/* frames.h - Allocator for 4KB and 4MB physical page frames
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _FRAMES_H
+#define _FRAMES_H
+
+#include "types.h"
+#include "x86_desc.h"
+#include "multiboot.h"
+
+/* Physical range the allocator may hand out. Everything below 8MB (kernel, PCBs, video memory)
+   is never given out. The kernel reaches frames through an identity map, so the pool stops
+   where user virtual memory starts at 128MB; RAM above that is left unused */
+#define FRAME_POOL_START EIGHT_MB
+#define FRAME_POOL_END ONE_TWO_EIGHT_MB
+#define NUM_POOL_FRAMES ((FRAME_POOL_END - FRAME_POOL_START) / FOUR_KB)
+
+// A large frame is one 4MB-aligned run of 4KB frames (one page directory entry)
+#define FRAMES_PER_LARGE (FOUR_MB / FOUR_KB)
+#define NUM_POOL_LARGE ((FRAME_POOL_END - FRAME_POOL_START) / FOUR_MB)
+
+// Multiboot memory map type of RAM the OS may use
+#define MULTIBOOT_MMAP_AVAILABLE 1
+// mem_upper counts KB of RAM starting here, used when the bootloader gives no memory map
+#define MULTIBOOT_UPPER_MEM_BASE 0x100000
+// Pool used when the bootloader reports no memory at all (the layout the kernel used to assume)
+#define FRAME_FALLBACK_END 0x2400000
+
+// Usage counters for the frame pool
+typedef struct frame_stats {
+    uint32_t total_frames;      // frames the memory map made available to the pool
+    uint32_t free_frames;       // frames currently free
+    uint32_t allocs;            // total successful frame_alloc() calls
+    uint32_t alloc_failures;    // frame_alloc() calls made while the pool was empty
+    uint32_t large_allocs;      // total successful frame_alloc_large() calls
+    uint32_t large_failures;    // frame_alloc_large() calls that found no fully free 4MB
+} frame_stats_t;
+
+frame_stats_t frame_stats;
+
+// Marks the usable RAM in the bootloader's memory map free, minus the boot modules (before paging)
+extern void frames_add_multiboot(multiboot_info_t* mbi);
+
+// Maps the pool into kernel space, falling back to a fixed pool if no memory was reported
+extern void init_frames(void);
+
+// Takes a free frame with a reference count of 1, returns its physical address or 0
+extern uint32_t frame_alloc(void);
+
+// Takes a whole free 4MB-aligned frame for the kernel, returns its physical address or 0
+extern uint32_t frame_alloc_large(void);
+
+// Gives back a frame from frame_alloc_large()
+extern void frame_free_large(uint32_t addr);
+
+// Adds a reference to a frame (no-op for frames outside the pool or not from frame_alloc)
+extern void frame_get(uint32_t addr);
+
+// Drops a reference to a frame and frees it when the last one goes (no-op as for frame_get)
+extern void frame_put(uint32_t addr);
+
+// Returns the number of references to a pool frame, 0 for large frames and frames outside the pool
+extern uint32_t frame_refcount(uint32_t addr);
+
+#endif /* _FRAMES_H */
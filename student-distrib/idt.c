@@ -16,6 +16,8 @@
 
 #include "system_calls.h"
 
+#include "paging.h"
+
 
 /*
 * enter all relevant exceptions into IDT table
@@ -166,6 +168,24 @@ void exception_handler(int32_t interrupt_vector){
     }
 }
 
+/*
+ * page_fault_handler
+ *    DESCRIPTION: Called by the page fault linkage before falling back to the generic exception path
+ *    INPUTS: fault_addr -- faulting linear address (CR2)
+ *            error_code -- error code the processor pushed for the fault
+ *    RETURNS: 0 if the fault was resolved and the instruction can be retried, -1 otherwise
+ *    SIDE EFFECTS: May map a page of the current program image or copy a shared one
+ */
+int32_t page_fault_handler(uint32_t fault_addr, uint32_t error_code) {
+    // Not-present faults inside the program page are first touches of the image
+    if(!(error_code & PF_ERR_PRESENT))
+        return demand_load_page(fault_addr);
+    // Writes to present pages can only be resolved if the page is copy-on-write
+    if(error_code & PF_ERR_WRITE)
+        return cow_fault(fault_addr);
+    return -1;
+}
+
 /*
  * halt_wrapper
  *    DESCRIPTION: Transitions to the halt syscall and setting exception_flag (Not rly a wrapper)
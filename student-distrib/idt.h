@@ -12,6 +12,11 @@
 
 #include "types.h"
 
+// Page fault error code bit that is set when the faulting page was present (protection violation)
+#define PF_ERR_PRESENT 0x1
+// Page fault error code bit that is set when the faulting access was a write
+#define PF_ERR_WRITE 0x2
+
 // Exception flag
 volatile int exception_flag;
 
@@ -21,6 +26,9 @@ extern void init_IDT();
 // Handles exceptions thrown by the processor
 extern void exception_handler(int32_t interrupt_vector);
 
+// Tries to resolve a page fault before it is treated as an exception
+extern int32_t page_fault_handler(uint32_t fault_addr, uint32_t error_code);
+
 // Wrapper for the halt system call used by the exceptions
 void halt_wrapper();
 
@@ -0,0 +1,104 @@
+/* image_cache.c - Cache of pristine program images keyed by inode
+ * vim:ts=4 noexpandtab
+ */
+
+#include "image_cache.h"
+#include "file_system.h"
+#include "frames.h"
+#include "lib.h"
+
+static image_cache_entry_t cache_entries[IMAGE_CACHE_ENTRIES];
+static uint32_t num_cache_entries;     // entries in use, filled in launch order and never evicted
+static uint8_t* cache_chunk;           // chunk new images go in, NULL if the cache has no memory
+static uint32_t cache_next_free;       // offset of the first unused byte in cache_chunk
+
+/*
+ * init_image_cache
+ *    DESCRIPTION: Marks every entry unused and takes the first 4MB chunk for images
+ *    INPUTS/OUTPUTS: none
+ *    SIDE EFFECTS: Allocates a large frame
+ *    NOTES: Must run after init_frames(). Without a free 4MB chunk every launch is uncacheable.
+ */
+void init_image_cache(void) {
+    num_cache_entries = 0;
+    cache_next_free = 0;
+    memset(&image_cache_stats, 0, sizeof(image_cache_stats));
+    cache_chunk = (uint8_t*)frame_alloc_large();
+    if(cache_chunk != NULL)
+        image_cache_stats.chunks = 1;
+}
+
+/*
+ * image_cache_grow
+ *    DESCRIPTION: Starts a new chunk when the current one can't hold the next image
+ *    INPUTS: none
+ *    RETURNS: 0 if there is a new, empty chunk, -1 if the cache may not grow
+ *    NOTES: The tail of the old chunk is left unused
+ */
+static int32_t image_cache_grow(void) {
+    uint32_t chunk;
+
+    if(image_cache_stats.chunks == IMAGE_CACHE_MAX_CHUNKS ||
+            frame_stats.free_frames < IMAGE_CACHE_RESERVE_FRAMES + FRAMES_PER_LARGE)
+        return -1;
+    chunk = frame_alloc_large();
+    if(chunk == 0)
+        return -1;
+
+    cache_chunk = (uint8_t*)chunk;
+    cache_next_free = 0;
+    image_cache_stats.chunks++;
+    return 0;
+}
+
+/*
+ * image_cache_get
+ *    DESCRIPTION: Finds the cached image of an executable, reading it in on the first launch
+ *    INPUTS: inode -- inode of the executable
+ *    OUTPUTS: none
+ *    RETURNS: the cache entry, or NULL if the image doesn't fit in what's left of the cache
+ *             and the cache can't take another chunk
+ *    SIDE EFFECTS: Updates hit/miss counters
+ *    NOTES: The file system is read-only, so a cached image never goes stale
+ */
+image_cache_entry_t* image_cache_get(uint32_t inode) {
+    uint64_t start = rdtsc();
+    image_cache_entry_t *entry;
+    uint32_t i, size, reserved;
+
+    for(i = 0; i < num_cache_entries; i++) {
+        if(cache_entries[i].inode == inode) {
+            cache_entries[i].launches++;
+            image_cache_stats.hits++;
+            return &cache_entries[i];
+        }
+    }
+
+    // Miss: reserve a page-aligned span so the image can be handed out one 4KB page at a time
+    size = fs_inode[inode].file_size;
+    reserved = (size + FOUR_KB - 1) & ~(FOUR_KB - 1);
+    if(num_cache_entries == IMAGE_CACHE_ENTRIES || cache_chunk == NULL || reserved > IMAGE_CACHE_CHUNK_SIZE ||
+            (reserved > IMAGE_CACHE_CHUNK_SIZE - cache_next_free && image_cache_grow() == -1)) {
+        image_cache_stats.uncacheable++;
+        return NULL;
+    }
+
+    entry = &cache_entries[num_cache_entries];
+    entry->inode = inode;
+    entry->size = size;
+    entry->image = cache_chunk + cache_next_free;
+    entry->launches = 1;
+    if(read_data(inode, 0, entry->image, size) != size) {
+        image_cache_stats.uncacheable++;
+        return NULL;
+    }
+
+    // Zero the slack so the tail of the last page reads like bss
+    memset(entry->image + size, 0, reserved - size);
+    cache_next_free += reserved;
+    num_cache_entries++;
+
+    image_cache_stats.misses++;
+    image_cache_stats.miss_cycles += (uint32_t)(rdtsc() - start);
+    return entry;
+}
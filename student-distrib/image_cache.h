@@ -0,0 +1,50 @@
+/* image_cache.h - Cache of pristine program images keyed by inode
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IMAGE_CACHE_H
+#define _IMAGE_CACHE_H
+
+#include "types.h"
+#include "x86_desc.h"
+
+/* Compile-time switch for the image cache. When defined, execute() builds each program image
+   from a cached copy of the executable instead of walking its data blocks on every launch.
+   Comment it out to measure launches without the cache. */
+#define USE_IMAGE_CACHE
+
+/* Cached images live in 4MB chunks taken from the frame allocator. The cache starts with one
+   and takes another when an image doesn't fit, as long as that leaves IMAGE_CACHE_RESERVE_FRAMES
+   4KB frames for processes, so machines with more RAM cache more programs */
+#define IMAGE_CACHE_CHUNK_SIZE FOUR_MB
+#define IMAGE_CACHE_MAX_CHUNKS 8
+#define IMAGE_CACHE_RESERVE_FRAMES 4096     // 16MB
+#define IMAGE_CACHE_ENTRIES 64      // max number of distinct executables cached at once
+
+// One cached executable, stored page aligned so it can be copied 4KB at a time
+typedef struct image_cache_entry {
+    uint32_t inode;         // inode of the executable this image was read from
+    uint32_t size;          // size of the executable in bytes
+    uint8_t* image;         // start of the cached copy inside a cache chunk
+    uint32_t launches;      // number of execute() calls served from this entry
+} image_cache_entry_t;
+
+// Hit/miss counters and cycle totals so launches can be compared with and without the cache
+typedef struct image_cache_stats {
+    uint32_t hits;          // launches whose image was already cached
+    uint32_t misses;        // launches that had to read the image from the file system
+    uint32_t uncacheable;   // launches whose image did not fit in the cache
+    uint32_t chunks;        // 4MB chunks the cache holds
+    uint32_t hit_cycles;    // cycles spent mapping program pages onto cached images
+    uint32_t miss_cycles;   // cycles spent filling cache entries from the file system
+} image_cache_stats_t;
+
+image_cache_stats_t image_cache_stats;
+
+// Empties the cache and takes its first chunk from the frame allocator
+extern void init_image_cache(void);
+
+// Returns the cache entry for inode, filling it on a miss, or NULL if it can't be cached
+extern image_cache_entry_t* image_cache_get(uint32_t inode);
+
+#endif /* _IMAGE_CACHE_H */
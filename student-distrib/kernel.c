@@ -16,6 +16,12 @@
 #include "system_calls.h"
 #include "pit.h"
 #include "terminal.h"
+#include "image_cache.h"
+#include "frames.h"
+#include "scheduler.h"
+#include "sysenter.h"
+#include "process.h"
+#include "pipe.h"
 
 #define RUN_TESTS
 
@@ -107,6 +113,9 @@ void entry(unsigned long magic, unsigned long addr) {
                     (unsigned)mmap->length_low);
     }
 
+    // Hand the usable RAM in the memory map to the frame allocator while the map is still reachable
+    frames_add_multiboot(mbi);
+
     /* Construct an LDT entry in the GDT */
     {
         seg_desc_t the_ldt_desc;
@@ -157,12 +166,25 @@ void entry(unsigned long magic, unsigned long addr) {
     // Initialize the IDT
     init_IDT();
 
+    // Fast system call entry, int $0x80 from init_IDT stays for everyone else
+    init_sysenter();
+
     /* Init the PIC */
     i8259_init();
 
     /* Enable paging */
     init_paging();
 
+    // Map the physical frame pool for the kernel (needs paging)
+    init_frames();
+
+    // Empty the program image cache and give it its first 4MB (needs the frame pool)
+    init_image_cache();
+
+    // Free the PIDs and set up the PCB and kernel stack caches
+    init_processes();
+    init_pipes();
+
     // MULTI-TERMINAL INITIALIZATION MOVED TO TOP OF FUNCTION AS PRINTING IS TERMINAL-BASED
     
     // Initialize RTC interrupts
@@ -171,8 +193,11 @@ void entry(unsigned long magic, unsigned long addr) {
     // Initialize Keyboard
     init_keyboard();
 
+    // Queue up the base shells (needs paging)
+    init_scheduler();
+
     // Initialize PIT
-    init_PIT();         //note: pit scheduling algorithm handles terminal bootup
+    init_PIT();         //note: the base shells start on the first PIT interrupt
 
     /* Enable interrupts */
     /* Do not enable the following until after you have set up your
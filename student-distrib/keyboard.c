@@ -9,6 +9,103 @@
 #include "terminal.h"
 #include "i8259.h"
 
+/*
+ * Scan codes are decoded with lookup tables instead of code: one keymap plane per combination
+ * of shift, caps lock and ctrl, a table for the extended (0xE0-prefixed) keys, and a table
+ * that says which keys are modifiers. The only state kept between interrupts is whether an
+ * 0xE0 prefix came in, which modifiers are down, and caps lock.
+ */
+
+// Keypad keys are digits, as if num lock were always on
+#define KEYPAD_KEYS \
+    '7', '8', '9', '-', '4', '5', '6', '+', '1', '2', '3', '0', '.'
+
+// Each plane is indexed by scan code (0x00 - 0x53), the codes after that make no key
+static const uint8_t keymap[NUM_KEYMAPS][NUM_SCAN_CODES] = {
+    [KEYMAP_NORMAL] = {
+    0, 0, '1', '2', '3', '4', '5', '6', '7', '8',
+    '9', '0', '-', '=', '\b', '\t', 'q', 'w', 'e', 'r',
+    't', 'y', 'u', 'i', 'o', 'p', '[', ']', '\n', 0,
+    'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l', ';',
+    '\'', '`', 0, '\\', 'z', 'x', 'c', 'v', 'b', 'n',
+    'm', ',', '.', '/', 0, '*', 0, ' ', 0, KEY_ALT_F1,
+    KEY_ALT_F1 + 1, KEY_ALT_F1 + 2, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, KEYPAD_KEYS
+    },
+    [KEYMAP_SHIFT] = {
+    0, 0, '!', '@', '#', '$', '%', '^', '&', '*',
+    '(', ')', '_', '+', '\b', '\t', 'Q', 'W', 'E', 'R',
+    'T', 'Y', 'U', 'I', 'O', 'P', '{', '}', '\n', 0,
+    'A', 'S', 'D', 'F', 'G', 'H', 'J', 'K', 'L', ':',
+    '"', '~', 0, '|', 'Z', 'X', 'C', 'V', 'B', 'N',
+    'M', '<', '>', '?', 0, '*', 0, ' ', 0, KEY_ALT_F1,
+    KEY_ALT_F1 + 1, KEY_ALT_F1 + 2, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, KEYPAD_KEYS
+    },
+    [KEYMAP_CAPS] = {
+    0, 0, '1', '2', '3', '4', '5', '6', '7', '8',
+    '9', '0', '-', '=', '\b', '\t', 'Q', 'W', 'E', 'R',
+    'T', 'Y', 'U', 'I', 'O', 'P', '[', ']', '\n', 0,
+    'A', 'S', 'D', 'F', 'G', 'H', 'J', 'K', 'L', ';',
+    '\'', '`', 0, '\\', 'Z', 'X', 'C', 'V', 'B', 'N',
+    'M', ',', '.', '/', 0, '*', 0, ' ', 0, KEY_ALT_F1,
+    KEY_ALT_F1 + 1, KEY_ALT_F1 + 2, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, KEYPAD_KEYS
+    },
+    // Shift undoes caps lock for letters only
+    [KEYMAP_CAPS | KEYMAP_SHIFT] = {
+    0, 0, '!', '@', '#', '$', '%', '^', '&', '*',
+    '(', ')', '_', '+', '\b', '\t', 'q', 'w', 'e', 'r',
+    't', 'y', 'u', 'i', 'o', 'p', '{', '}', '\n', 0,
+    'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l', ':',
+    '"', '~', 0, '|', 'z', 'x', 'c', 'v', 'b', 'n',
+    'm', '<', '>', '?', 0, '*', 0, ' ', 0, KEY_ALT_F1,
+    KEY_ALT_F1 + 1, KEY_ALT_F1 + 2, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, KEYPAD_KEYS
+    },
+    // Ctrl + letter is its control code (ctrl + L = KEY_CTRL_L), editing keys still work
+    [KEYMAP_CTRL] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, '\b', '\t', 0x11, 0x17, 0x05, 0x12,
+    0x14, 0x19, 0x15, 0x09, 0x0F, 0x10, 0, 0, '\n', 0,
+    0x01, 0x13, 0x04, 0x06, 0x07, 0x08, 0x0A, 0x0B, 0x0C, 0,
+    0, 0, 0, 0, 0x1A, 0x18, 0x03, 0x16, 0x02, 0x0E,
+    0x0D, 0, 0, 0, 0, 0, 0, ' ', 0, 0
+    }
+};
+
+// Keys that only exist as extended codes, other extended codes (like the fake shifts some
+// keyboards send around the cursor keys) make nothing
+static const uint8_t extended_keymap[NUM_SCAN_CODES] = {
+    [SCAN_KEYPAD_ENTER] = '\n',
+    [SCAN_KEYPAD_SLASH] = '/',
+    [SCAN_HOME] = KEY_HOME,
+    [SCAN_UP] = KEY_UP,
+    [SCAN_LEFT] = KEY_LEFT,
+    [SCAN_RIGHT] = KEY_RIGHT,
+    [SCAN_END] = KEY_END,
+    [SCAN_DOWN] = KEY_DOWN,
+    [SCAN_DELETE] = KEY_DELETE
+};
+
+// Modifier bit of each key, [0] for normal codes and [1] for extended ones
+static const uint8_t modifier_map[2][NUM_SCAN_CODES] = {
+    {
+    [LEFT_SHIFT_PRESSED] = MOD_LEFT_SHIFT,
+    [RIGHT_SHIFT_PRESSED] = MOD_RIGHT_SHIFT,
+    [LEFT_CTRL_PRESSED] = MOD_LEFT_CTRL,
+    [LEFT_ALT_PRESSED] = MOD_LEFT_ALT
+    },
+    {
+    [LEFT_CTRL_PRESSED] = MOD_RIGHT_CTRL,
+    [LEFT_ALT_PRESSED] = MOD_RIGHT_ALT
+    }
+};
+
+static uint32_t kb_state = KB_STATE_NORMAL;
+static uint8_t kb_modifiers = 0;
+static uint8_t kb_caps_lock = 0;
+
 
 /*
  * init_keyboard
@@ -21,232 +118,341 @@ void init_keyboard(){
 }
 
 /*
- * keyboard_handler
- *    DESCRIPTION: Handler for keyboard interrupts
- *    INPUTS/OUTPUTS: none  
+ * keyboard_translate
+ *    DESCRIPTION: Runs one scan code through the decoder
+ *    INPUTS: scan_code -- byte read from the keyboard
+ *    OUTPUTS: none
+ *    RETURNS: The key it completes, ASCII or one of the KEY_* codes, 0 for prefixes,
+ *             releases, modifiers and keys that mean nothing
+ *    SIDE EFFECTS: Tracks the 0xE0 prefix, modifiers and caps lock
  */
-void keyboard_handler() {
-    /* scan_code stores the hex value of the key that is stored in the keyboard port */
-    // Scan code + 0x80 is that key but released/"de-pressed"
-    // ASCII + 0x20 is the lower case of that letter
-    
-    // Index is the scan code, the value at an index is that scan code key's ASCII
-    int scan_code_to_ascii[] = {
-    0, 0x1B, '1', '2', '3', '4', '5', '6', '7', '8',
-    '9', '0', '-', '=', '\b', '\t', 'q', 'w', 'e', 'r',
-    't', 'y', 'u', 'i', 'o', 'p', '[', ']', '\n', 0,
-    'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l', ';',
-    '\'', '`', 0, '\\', 'z', 'x', 'c', 'v', 'b', 'n',
-    'm', ',', '.', '/', 0, '*', 0, ' ', 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, '7', '8', '9', '-', '4', '5', '6', '+', '1',
-    '2', '3', '0', '.', 0, 0, 0, 0, 0
-    };
+uint8_t keyboard_translate(uint8_t scan_code) {
+    uint32_t extended, plane;
+    uint8_t modifier, key;
 
-    int temp_i;   // Temp var used for tab loop index
+    // The prefix only says which table the next code goes to
+    if(scan_code == SCAN_EXTENDED) {
+        kb_state = KB_STATE_EXTENDED;
+        return 0;
+    }
+    extended = (kb_state == KB_STATE_EXTENDED);
+    kb_state = KB_STATE_NORMAL;
+
+    // Modifiers are held while down, everything else only acts when pressed
+    modifier = modifier_map[extended][scan_code & ~SCAN_RELEASED];
+    if(modifier != 0) {
+        if(scan_code & SCAN_RELEASED)
+            kb_modifiers &= ~modifier;
+        else
+            kb_modifiers |= modifier;
+        return 0;
+    }
+    if(scan_code & SCAN_RELEASED)
+        return 0;
 
-    // Define alias vars for readability (using visible_terminal as the keyboard types to visible terminal)
-    char * kb_buf = terminals[visible_terminal].kb_buf;
-    volatile int32_t * kb_buf_i = &terminals[visible_terminal].kb_buf_i;
+    if(extended)
+        return extended_keymap[scan_code];
 
-    // Get scan code from keyboard
-    int scan_code = inb(KEYBOARD_PORT);
+    if(scan_code == CAPS_LOCK_PRESSED) {
+        kb_caps_lock = !kb_caps_lock;
+        return 0;
+    }
 
-    // Set flags is control character key is pressed
-    switch(scan_code){
-        case LEFT_SHIFT_PRESSED:
-            left_shift_flag = 1;
-            break;
-        case LEFT_SHIFT_RELEASED:
-            left_shift_flag = 0;
+    if(kb_modifiers & MOD_CTRL)
+        plane = KEYMAP_CTRL;
+    else
+        plane = ((kb_modifiers & MOD_SHIFT) ? KEYMAP_SHIFT : 0) | (kb_caps_lock ? KEYMAP_CAPS : 0);
+    key = keymap[plane][scan_code];
+
+    // F keys only mean something with alt
+    if(key >= KEY_ALT_F1 && key < KEY_ALT_F1 + MAX_TERMINALS && !(kb_modifiers & MOD_ALT))
+        return 0;
+    return key;
+}
+
+/*
+ * keyboard_echo
+ *    DESCRIPTION: Draws part of the line being typed from the cursor on, then puts the cursor back
+ *    INPUTS: terminal_id -- terminal being typed in
+ *            from, to -- ring indices of the chars to draw
+ *            blanks -- spaces to draw after them, to wipe chars the line no longer has
+ *            back -- how far to move the cursor back once done
+ *    OUTPUTS: none
+ *    RETURNS: none
+ */
+static void keyboard_echo(int32_t terminal_id, uint32_t from, uint32_t to, uint32_t blanks, uint32_t back) {
+    terminal_t * term = &terminals[terminal_id];
+    int8_t buf[2 * KEYBOARD_BUF_SIZE];
+    uint32_t n = 0;
+
+    while(from != to && n < sizeof(buf))
+        buf[n++] = term->kb_ring[from++ & KEYBOARD_RING_MASK];
+    while(blanks-- > 0 && n < sizeof(buf))
+        buf[n++] = ' ';
+
+    if(n > 0)
+        (void)write_screen(terminal_id, buf, n);
+    if(back > 0)
+        move_cursor(-(int32_t)back);
+}
+
+/*
+ * keyboard_delete_char
+ *    DESCRIPTION: Takes a char out of the line being typed and closes the gap
+ *    INPUTS: terminal_id -- terminal being typed in
+ *            at -- ring index of the char, in [kb_head, kb_edit)
+ *    OUTPUTS: none
+ *    RETURNS: none
+ *    NOTES: Doesn't touch the screen or the cursor
+ */
+static void keyboard_delete_char(int32_t terminal_id, uint32_t at) {
+    terminal_t * term = &terminals[terminal_id];
+
+    for(; at + 1 != term->kb_edit; at++)
+        term->kb_ring[at & KEYBOARD_RING_MASK] = term->kb_ring[(at + 1) & KEYBOARD_RING_MASK];
+    term->kb_edit--;
+}
+
+/*
+ * keyboard_save_history
+ *    DESCRIPTION: Remembers the line being typed for up/down, unless it's empty or repeats the last one
+ *    INPUTS: terminal_id -- terminal being typed in
+ *    OUTPUTS: none
+ *    RETURNS: none
+ */
+static void keyboard_save_history(int32_t terminal_id) {
+    terminal_t * term = &terminals[terminal_id];
+    char line[KEYBOARD_BUF_SIZE];
+    uint32_t len = term->kb_edit - term->kb_head;
+    uint32_t i;
+
+    if(len == 0)
+        return;
+    for(i = 0; i < len; i++)
+        line[i] = term->kb_ring[(term->kb_head + i) & KEYBOARD_RING_MASK];
+    line[len] = '\0';
+
+    if(term->kb_history_count != 0 &&
+       strncmp(line, term->kb_history[(term->kb_history_count - 1) & KEYBOARD_HISTORY_MASK], KEYBOARD_BUF_SIZE) == 0)
+        return;
+    strcpy(term->kb_history[term->kb_history_count & KEYBOARD_HISTORY_MASK], line);
+    term->kb_history_count++;
+}
+
+/*
+ * keyboard_replace_line
+ *    DESCRIPTION: Swaps the line being typed for another one, on screen too, with the cursor at its end
+ *    INPUTS: terminal_id -- terminal being typed in
+ *            line -- new text, NUL-terminated
+ *    OUTPUTS: none
+ *    RETURNS: none
+ */
+static void keyboard_replace_line(int32_t terminal_id, const char * line) {
+    terminal_t * term = &terminals[terminal_id];
+    uint32_t old_len = term->kb_edit - term->kb_head;
+    uint32_t new_len;
+
+    move_cursor(-(int32_t)(term->kb_cursor - term->kb_head));
+    term->kb_edit = term->kb_cursor = term->kb_head;
+    while(*line != '\0' && keyboard_put_char(terminal_id, *line) == 0)
+        line++;
+
+    new_len = term->kb_edit - term->kb_head;
+    old_len = old_len > new_len ? old_len - new_len : 0;
+    keyboard_echo(terminal_id, term->kb_head, term->kb_edit, old_len, old_len);
+}
+
+/*
+ * keyboard_edit
+ *    DESCRIPTION: Applies a key to the line being typed in a terminal and to its screen
+ *    INPUTS: terminal_id -- terminal being typed in
+ *            key -- what keyboard_translate made
+ *    OUTPUTS: none
+ *    RETURNS: none
+ *    NOTES: Lines already entered can't be edited, everything here stays in [kb_head, kb_edit)
+ */
+static void keyboard_edit(int32_t terminal_id, uint8_t key) {
+    terminal_t * term = &terminals[terminal_id];
+    uint32_t oldest;
+    int temp_i;   // Temp var used for tab loop index
+
+    switch(key) {
+        case 0:
             break;
-        case RIGHT_SHIFT_PRESSED:
-            right_shift_flag = 1;
+
+        // Delete the char before the cursor
+        case '\b':
+            if(term->kb_cursor == term->kb_head)
+                break;
+            term->kb_cursor--;
+            keyboard_delete_char(terminal_id, term->kb_cursor);
+            move_cursor(-1);
+            keyboard_echo(terminal_id, term->kb_cursor, term->kb_edit, 1, term->kb_edit - term->kb_cursor + 1);
             break;
-        case RIGHT_SHIFT_RELEASED:
-            right_shift_flag = 0;
+
+        // Delete the char under the cursor
+        case KEY_DELETE:
+            if(term->kb_cursor == term->kb_edit)
+                break;
+            keyboard_delete_char(terminal_id, term->kb_cursor);
+            keyboard_echo(terminal_id, term->kb_cursor, term->kb_edit, 1, term->kb_edit - term->kb_cursor + 1);
             break;
-        case CAPS_LOCK_PRESSED:
-            caps_flag = !caps_flag;
+
+        // Enter hands the whole line to terminal_read wherever the cursor is
+        case '\n':
+            move_cursor(term->kb_edit - term->kb_cursor);
+            keyboard_save_history(terminal_id);
+            if(keyboard_end_line(terminal_id) == 0) {
+                term->kb_history_pos = term->kb_history_count;
+                wake_up(&term->kb_wait);
+                putc('\n',1);
+            }
             break;
-        case LEFT_CTRL_PRESSED:
-            ctrl_flag = 1;
+
+        // Ctrl + L clears the screen and prints the line being typed again
+        case KEY_CTRL_L:
+            clear();
+            keyboard_echo(terminal_id, term->kb_head, term->kb_edit, 0, term->kb_edit - term->kb_cursor);
             break;
-        case LEFT_CTRL_RELEASED:
-            ctrl_flag = 0;
+
+        // Tab = 8 spaces, clipping on overflow
+        case '\t':
+            for(temp_i = 0; temp_i < 8; temp_i++)
+                if(keyboard_put_char(terminal_id, ' ') != 0)
+                    break;
+            if(temp_i > 0)
+                keyboard_echo(terminal_id, term->kb_cursor - temp_i, term->kb_edit, 0, term->kb_edit - term->kb_cursor);
             break;
-        case LEFT_ALT_PRESSED:
-            alt_flag = 1;
+
+        case KEY_LEFT:
+            if(term->kb_cursor != term->kb_head) {
+                term->kb_cursor--;
+                move_cursor(-1);
+            }
             break;
-        case LEFT_ALT_RELEASED:
-            alt_flag = 0;
+
+        case KEY_RIGHT:
+            if(term->kb_cursor != term->kb_edit) {
+                term->kb_cursor++;
+                move_cursor(1);
+            }
             break;
-    }
 
-    // Ignore key releases (F4 pressed is 0x3B, any scan codes greater than that are releases)
-    if(scan_code >= 0x3E || scan_code == LEFT_SHIFT_PRESSED || scan_code == RIGHT_SHIFT_PRESSED || scan_code == CAPS_LOCK_PRESSED ||
-        scan_code == LEFT_CTRL_PRESSED || scan_code == LEFT_ALT_PRESSED) {
-        send_eoi(KEYBOARD_IRQ);
-        return;
-    }
+        case KEY_HOME:
+            move_cursor(-(int32_t)(term->kb_cursor - term->kb_head));
+            term->kb_cursor = term->kb_head;
+            break;
 
-    // Convert scan code to ASCII equivalent
-    char key_pressed = scan_code_to_ascii[scan_code];
+        case KEY_END:
+            move_cursor(term->kb_edit - term->kb_cursor);
+            term->kb_cursor = term->kb_edit;
+            break;
 
-    // Backspace pressed: delete prev char if buffer isn't empty, then return from interrupt
-    if(key_pressed == '\b') {
-        if(*kb_buf_i > 0) {
-            (*kb_buf_i)--;
-            putc('\b',1);
-        }
-        send_eoi(KEYBOARD_IRQ);
-        return;
-    }
-    
-    // If enter pressed, print newline, set enter_flag, and return from interrupt (terminal_read will clear buf)
-    if(key_pressed == '\n') {
-        kb_buf[*kb_buf_i] = key_pressed;
-        (*kb_buf_i)++;
-        terminals[visible_terminal].kb_enter_flag = 1;
-        putc('\n',1);
-        send_eoi(KEYBOARD_IRQ);
-        return;
-    }
+        // Up goes back through the lines entered, as far as the history reaches
+        case KEY_UP:
+            oldest = term->kb_history_count > KEYBOARD_HISTORY_SIZE ?
+                     term->kb_history_count - KEYBOARD_HISTORY_SIZE : 0;
+            if(term->kb_history_pos == oldest)
+                break;
+            term->kb_history_pos--;
+            keyboard_replace_line(terminal_id, term->kb_history[term->kb_history_pos & KEYBOARD_HISTORY_MASK]);
+            break;
 
-    // Ctrl + l and Ctrl + L clears screen and prints keyboard buffer again
-    if(ctrl_flag && (key_pressed == 'l' || key_pressed == 'L')) {
-        clear();
-        terminal_write(NULL, kb_buf, *kb_buf_i);
-        send_eoi(KEYBOARD_IRQ);
-        return;
-    }
+        // Down comes forward again, past the newest entry is an empty line
+        case KEY_DOWN:
+            if(term->kb_history_pos == term->kb_history_count)
+                break;
+            term->kb_history_pos++;
+            if(term->kb_history_pos == term->kb_history_count)
+                keyboard_replace_line(terminal_id, "");
+            else
+                keyboard_replace_line(terminal_id, term->kb_history[term->kb_history_pos & KEYBOARD_HISTORY_MASK]);
+            break;
 
-    // Case for alt flag for terminal switching
-    if(alt_flag) {
-        // Alt + F1
-        if(scan_code==TERMINAL_ONE){    
-            switch_visible_terminal(0);       //pass in terminal id to switch to
-            send_eoi(KEYBOARD_IRQ);
-            return;
-        }
-
-        // Alt + F2
-        if(scan_code==TERMINAL_TWO){
-            switch_visible_terminal(1);
-            send_eoi(KEYBOARD_IRQ);
-            return;
-        }
-
-        // Alt + F3
-        if(scan_code == TERMINAL_THREE) {
-            switch_visible_terminal(2);
-            send_eoi(KEYBOARD_IRQ);
-            return;
-        }
+        // Printable chars go in at the cursor (ignored if the line is full), other control codes do nothing
+        default:
+            if(key < ' ' || key >= 0x7F)
+                break;
+            if(keyboard_put_char(terminal_id, key) == 0)
+                keyboard_echo(terminal_id, term->kb_cursor - 1, term->kb_edit, 0, term->kb_edit - term->kb_cursor);
+            break;
     }
+}
 
-    // If entering a char will overflow either buffer (only buf_size-1 chars + '\n' allowed), ignore the key press
-    if(*kb_buf_i == KEYBOARD_BUF_CHAR_MAX || *kb_buf_i == terminal_buf_n_bytes - 1) {
-        send_eoi(KEYBOARD_IRQ);
-        return;
-    }
+/*
+ * keyboard_handler
+ *    DESCRIPTION: Handler for keyboard interrupts
+ *    INPUTS/OUTPUTS: none  
+ */
+void keyboard_handler() {
+    // Get scan code from keyboard and decode it
+    uint8_t key = keyboard_translate(inb(KEYBOARD_PORT));
 
-    if(key_pressed == '\t') {
-        // Tab = 8 spaces, clipping on overflow
-        for(temp_i = 0; temp_i < 8; temp_i++) {
-            if(*kb_buf_i < KEYBOARD_BUF_CHAR_MAX && *kb_buf_i < terminal_buf_n_bytes - 1) {
-                kb_buf[*kb_buf_i] = ' ';
-                (*kb_buf_i)++;
-                putc(' ',1);
-            }
-            else 
-                break;
-        }
+    // Alt + F1/F2/F3 switches terminals
+    if(key >= KEY_ALT_F1 && key < KEY_ALT_F1 + MAX_TERMINALS) {
+        switch_visible_terminal(key - KEY_ALT_F1);       //pass in terminal id to switch to
         send_eoi(KEYBOARD_IRQ);
         return;
     }
 
-    // Handle caps lock and shift for letter keys (ignored if shift is held by XOR)
-    if((caps_flag ^ (left_shift_flag || right_shift_flag)) && (key_pressed >= 97 && key_pressed <= 122)){
-        key_pressed = key_pressed - 32; // Subtracting letter ASCII by 32 maps to caps
-    }
-
-    // Handle shift for special characters
-    if((left_shift_flag || right_shift_flag)) {
-        // Map special characters
-        switch(key_pressed){
-            case '`':
-                key_pressed = '~';
-                break;
-            case '1':
-                key_pressed = '!';
-                break;
-            case '2':
-                key_pressed = '@';
-                break;
-            case '3':
-                key_pressed = '#';
-                break;
-            case '4':
-                key_pressed = '$';
-                break;
-            case '5':
-                key_pressed = '%';
-                break;
-            case '6':
-                key_pressed = '^';
-                break;
-            case '7':
-                key_pressed = '&';
-                break;
-            case '8':
-                key_pressed = '*';
-                break;
-            case '9':
-                key_pressed = '(';
-                break;
-            case '0':
-                key_pressed = ')';
-                break;
-            case '-':
-                key_pressed = '_';
-                break;
-            case '=':
-                key_pressed = '+';
-                break;
-            case '[':
-                key_pressed = '{';
-                break;
-            case ']':
-                key_pressed = '}';
-                break;
-            case '\\':
-                key_pressed = '|';
-                break;
-            case ';':
-                key_pressed = ':';
-                break;
-            case '\'':
-                key_pressed = '"';
-                break;
-            case ',':
-                key_pressed = '<';
-                break;
-            case '.':
-                key_pressed = '>';
-                break;
-            case '/':
-                key_pressed = '?';
-                break;
-        }
-    }
-    
-    // Put key pressed in buffer and on screen and advance buffer index
-    kb_buf[*kb_buf_i] = key_pressed;
-    (*kb_buf_i)++;  
-    putc(key_pressed,1);
+    // The keyboard types to the visible terminal
+    keyboard_edit(visible_terminal, key);
     
     // Send EOI to PIC
     send_eoi(KEYBOARD_IRQ);         // 0x01 is IRQ number for keyboard
+
+    // Let a reader woken by enter run now if it outranks whatever got interrupted
+    if(key == '\n')
+        sched_preempt();
+}
+
+/*
+ * keyboard_put_char
+ *    DESCRIPTION: Adds a char at the cursor of the line being typed in a terminal
+ *    INPUTS: terminal_id -- terminal being typed in
+ *            c -- char to add
+ *    OUTPUTS: none
+ *    RETURNS: 0 on success, -1 if the line is at KEYBOARD_BUF_CHAR_MAX or the ring is full
+ *    NOTES: Producer side of the ring, only the keyboard handler calls this. The char isn't
+ *           visible to terminal_read until the line ends. Doesn't touch the screen
+ */
+int32_t keyboard_put_char(int32_t terminal_id, char c) {
+    terminal_t * term = &terminals[terminal_id];
+    uint32_t i;
+
+    // Keep one slot free for the '\n' that ends the line
+    if(term->kb_edit - term->kb_head >= KEYBOARD_BUF_CHAR_MAX ||
+       term->kb_edit - term->kb_tail >= KEYBOARD_RING_SIZE - 1)
+        return -1;
+
+    // Make room at the cursor by moving the rest of the line up one
+    for(i = term->kb_edit; i != term->kb_cursor; i--)
+        term->kb_ring[i & KEYBOARD_RING_MASK] = term->kb_ring[(i - 1) & KEYBOARD_RING_MASK];
+    term->kb_ring[term->kb_cursor & KEYBOARD_RING_MASK] = c;
+    term->kb_edit++;
+    term->kb_cursor++;
+    return 0;
 }
 
+/*
+ * keyboard_end_line
+ *    DESCRIPTION: Ends the line being typed with '\n' and makes it readable
+ *    INPUTS: terminal_id -- terminal being typed in
+ *    OUTPUTS: none
+ *    RETURNS: 0 on success, -1 if the ring is full of lines nobody has read
+ *    NOTES: Publishing is a single store to kb_head after the chars are in place,
+ *           so terminal_read never needs interrupts off to read a line
+ */
+int32_t keyboard_end_line(int32_t terminal_id) {
+    terminal_t * term = &terminals[terminal_id];
+
+    if(term->kb_edit - term->kb_tail >= KEYBOARD_RING_SIZE)
+        return -1;
+
+    term->kb_ring[term->kb_edit & KEYBOARD_RING_MASK] = '\n';
+    term->kb_edit++;
+    asm volatile ("" ::: "memory");     // The line has to be in the ring before kb_head says so
+    term->kb_head = term->kb_edit;
+    term->kb_cursor = term->kb_edit;
+    return 0;
+}
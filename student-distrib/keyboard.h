@@ -11,20 +11,65 @@
 
 #define KEYBOARD_PORT           0x60
 #define KEYBOARD_IRQ            0x01
+
+// Scan codes (set 1). A key's release is its press code with SCAN_RELEASED set
+#define SCAN_RELEASED           0x80
+#define SCAN_EXTENDED           0xE0    // prefix, the next code is from the extended set
+#define NUM_SCAN_CODES          0x80
 #define LEFT_SHIFT_PRESSED      0x2A
 #define RIGHT_SHIFT_PRESSED     0x36
-#define LEFT_SHIFT_RELEASED     0xAA
-#define RIGHT_SHIFT_RELEASED    0xB6
 #define CAPS_LOCK_PRESSED       0x3A
-#define LEFT_CTRL_PRESSED       0x1D
-#define LEFT_CTRL_RELEASED      0x9D
-#define LEFT_ALT_PRESSED        0x38
-#define LEFT_ALT_RELEASED       0xB8
+#define LEFT_CTRL_PRESSED       0x1D    // right ctrl with SCAN_EXTENDED
+#define LEFT_ALT_PRESSED        0x38    // right alt with SCAN_EXTENDED
+#define SCAN_HOME               0x47    // the cursor keys are extended codes, the same codes
+#define SCAN_UP                 0x48    // without SCAN_EXTENDED are the keypad digits
+#define SCAN_LEFT               0x4B
+#define SCAN_RIGHT              0x4D
+#define SCAN_END                0x4F
+#define SCAN_DOWN               0x50
+#define SCAN_DELETE             0x53
+#define SCAN_KEYPAD_ENTER       0x1C    // extended
+#define SCAN_KEYPAD_SLASH       0x35    // extended
+
+// Scan code decoder states
+#define KB_STATE_NORMAL         0
+#define KB_STATE_EXTENDED       1       // got SCAN_EXTENDED, waiting for the code
+
+// Keymap planes, picked by the modifiers held. Caps and shift planes combine by OR
+#define KEYMAP_NORMAL           0
+#define KEYMAP_SHIFT            1
+#define KEYMAP_CAPS             2
+#define KEYMAP_CTRL             4
+#define NUM_KEYMAPS             5
+
+// Modifier bits, each side of a modifier is tracked on its own
+#define MOD_LEFT_SHIFT          0x01
+#define MOD_RIGHT_SHIFT         0x02
+#define MOD_LEFT_CTRL           0x04
+#define MOD_RIGHT_CTRL          0x08
+#define MOD_LEFT_ALT            0x10
+#define MOD_RIGHT_ALT           0x20
+#define MOD_SHIFT               (MOD_LEFT_SHIFT | MOD_RIGHT_SHIFT)
+#define MOD_CTRL                (MOD_LEFT_CTRL | MOD_RIGHT_CTRL)
+#define MOD_ALT                 (MOD_LEFT_ALT | MOD_RIGHT_ALT)
+
+// Keys the line editor handles that aren't printable ASCII
+#define KEY_CTRL_L              0x0C
+#define KEY_UP                  0x80
+#define KEY_DOWN                0x81
+#define KEY_LEFT                0x82
+#define KEY_RIGHT               0x83
+#define KEY_HOME                0x84
+#define KEY_END                 0x85
+#define KEY_DELETE              0x86
+#define KEY_ALT_F1              0x87    // alt + F2 and F3 follow it, F keys alone make nothing
+
 #define KEYBOARD_BUF_SIZE       128
-#define KEYBOARD_BUF_CHAR_MAX   127
-#define TERMINAL_ONE            0x3B
-#define TERMINAL_TWO            0x3C
-#define TERMINAL_THREE          0x3D
+#define KEYBOARD_BUF_CHAR_MAX   127     // longest line that can be typed, not counting the '\n'
+#define KEYBOARD_RING_SIZE      512     // room for several typed-ahead lines, must be a power of 2
+#define KEYBOARD_RING_MASK      (KEYBOARD_RING_SIZE - 1)
+#define KEYBOARD_HISTORY_SIZE   16      // lines each terminal remembers for up/down, must be a power of 2
+#define KEYBOARD_HISTORY_MASK   (KEYBOARD_HISTORY_SIZE - 1)
 
 //------------------------VARS DEPRECATED IN CP5------------------------------ 
 
@@ -39,24 +84,19 @@
 
 //--------------------------END DEPRECATED VARS-----------------------------
 
-// Holds the arg "n_bytes" passed into terminal_read (is this meaningless?)
-int terminal_buf_n_bytes;
-
-// Keyboard flags
-int left_shift_flag;
-
-int right_shift_flag;
-
-int ctrl_flag;
-
-int caps_flag;
-
-int alt_flag;
-
 // Initialize the keyboard by enabling the PIC IRQ
 void init_keyboard();
 
 // Handles Keyboard interrupts
 extern void keyboard_handler();
 
+// Turns one scan code into a key (ASCII or KEY_*), 0 if it doesn't make one
+extern uint8_t keyboard_translate(uint8_t scan_code);
+
+// Adds a char at the cursor of the line being typed in a terminal, returns -1 if the line or ring is full
+extern int32_t keyboard_put_char(int32_t terminal_id, char c);
+
+// Ends the line being typed with '\n' and hands it to terminal_read, returns -1 if the ring is full
+extern int32_t keyboard_end_line(int32_t terminal_id);
+
 #endif /* _KEYBOARD_H */
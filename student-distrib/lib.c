@@ -8,6 +8,8 @@
 #define NUM_COLS    80
 #define NUM_ROWS    25
 #define ATTRIB      0x7
+#define ROW_BYTES   (NUM_COLS * 2)          // a row is NUM_COLS (char, attribute) pairs
+#define BLANK_CELL  ((ATTRIB << 8) | ' ')   // one blank char cell, written as a 16-bit word
 
 static int screen_x;
 static int screen_y;
@@ -19,11 +21,7 @@ static char* video_mem = (char *)VIDEO;
  * Function: Clears video memory and resets cursor to (0,0) 
  * NOTES: Only visible terminal will call this (CTRL + L and kernel bootup only) */
 void clear(void) {
-    int32_t i;
-    for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        *(uint8_t *)(video_mem + (i << 1)) = ' ';
-        *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
-    }
+    memset_word(video_mem, BLANK_CELL, NUM_ROWS * NUM_COLS);
     // Reset screen coordinates
     update_cursor(0, 0);    // update_cursor also sets screen_x and screen_y
     terminals[visible_terminal].cursor_x = 0;
@@ -161,12 +159,7 @@ format_char_switch:
  *   Return Value: Number of bytes written
  *    Function: Output a string to the console */
 int32_t puts(int8_t* s) {
-    register int32_t index = 0;
-    while (s[index] != '\0') {
-        putc(s[index], 0);
-        index++;
-    }
-    return index;
+    return write_screen(scheduled_terminal, s, strlen(s));
 }
 
 /* void enable_cursor(void)
@@ -204,6 +197,21 @@ void update_cursor(int x, int y)
 	outb((uint8_t) ((pos >> 8) & 0xFF), 0x3D5);     // Bitmask and update y-coordinate
 }
 
+/* void move_cursor(int32_t offset);
+ * Inputs: offset = chars to move by, negative to move back
+ * Return Value: void
+ *  Function: Moves the visible terminal's cursor along its text without changing any of it,
+ *            wrapping between rows and stopping at the corners of the screen */
+void move_cursor(int32_t offset) {
+    int32_t pos = screen_y * NUM_COLS + screen_x + offset;
+
+    if(pos < 0)
+        pos = 0;
+    if(pos >= NUM_ROWS * NUM_COLS)
+        pos = NUM_ROWS * NUM_COLS - 1;
+    update_cursor(pos % NUM_COLS, pos / NUM_COLS);
+}
+
 /* int get_screen_x(void);
  * Inputs: none
  * Return Value: The x-coordinate of the screen
@@ -220,107 +228,159 @@ int get_screen_y() {
     return screen_y;
 }
 
-/* void scroll(void);
- * Inputs: none
+/* void scroll(char* screen, int32_t lines);
+ * Inputs: screen = text page to scroll (VGA memory or a terminal's background page)
+ *         lines = number of lines to scroll by
  * Return Value: void
- *  Function: Scrolls each line on screen up by one line, losing the 0th row and clearing the 24th row*/
-void scroll(void){
-    int i;
-    int j;
-    for(i = 0; i < NUM_ROWS; i++){
-        for(j = 0; j < NUM_COLS; j++){
-            // Blank 24th row
-            if(i == NUM_ROWS - 1)
-                *(uint8_t *)(video_mem + ((NUM_COLS * i + j) << 1)) = ' ';
-            // Scroll up by copying the below line to current line
-            else    
-                *(uint8_t *)(video_mem + ((NUM_COLS * i + j) << 1)) = *(uint8_t *)(video_mem + ((NUM_COLS * (i+1) + j) << 1));
-        }
-    }
+ *  Function: Moves every line on screen up by lines, losing the top rows and blanking the bottom ones */
+void scroll(char* screen, int32_t lines){
+    if(lines <= 0)
+        return;
+    if(lines > NUM_ROWS)
+        lines = NUM_ROWS;
+
+    memmove(screen, screen + lines * ROW_BYTES, (NUM_ROWS - lines) * ROW_BYTES);
+    memset_word(screen + (NUM_ROWS - lines) * ROW_BYTES, BLANK_CELL, lines * NUM_COLS);
 }
 
-/* void putc(uint8_t c);
- * Inputs: uint_8* c = character to print
- *         int keyboard_flag = denotes whether or not this was called from keyboard
- * Return Value: void
- *  Function: Output a character to the console */
-void putc(uint8_t c, int keyboard_flag) {
+/* char* terminal_screen(int32_t terminal_id);
+ * Inputs: terminal_id = terminal whose text we want
+ * Return Value: VGA memory if the terminal is on screen, its background page otherwise
+ *  Function: Finds where a terminal's text lives right now. Background pages are identity
+ *            mapped, so no paging changes are needed to write to them */
+static char* terminal_screen(int32_t terminal_id) {
+    if(terminal_id == visible_terminal)
+        return video_mem;
+    return video_mem + (terminal_id + 1) * FOUR_KB;
+}
 
-    // Ignore NULL bytes
-    if(c == '\0')
-        return;
+/* uint32_t render_text(char* screen, int32_t* cursor_x, int32_t* cursor_y, const int8_t* buf,
+ *                       int32_t n_bytes, uint32_t total_scrolls);
+ * Inputs: screen = text page to draw into, or NULL to only work out where the cursor goes
+ *         cursor_x, cursor_y = cursor to start from, updated to where the text ends
+ *         buf, n_bytes = chars to print
+ *         total_scrolls = scrolls this text needs, already done to screen up front
+ * Return Value: number of times the text scrolls the screen
+ *  Function: Walks the text like a terminal would, one scroll per line past the bottom row.
+ *            When drawing, the screen was already shifted by every scroll at once, so a char
+ *            that the walk puts at row y after k scrolls lands at row y - (total_scrolls - k),
+ *            and chars that would have scrolled off the top are skipped */
+static uint32_t render_text(char* screen, int32_t* cursor_x, int32_t* cursor_y, const int8_t* buf,
+                            int32_t n_bytes, uint32_t total_scrolls) {
+    int32_t i, row;
+    int32_t x = *cursor_x;
+    int32_t y = *cursor_y;
+    uint32_t scrolls = 0;
+    uint8_t c;
+
+    for(i = 0; i < n_bytes; i++) {
+        c = buf[i];
+
+        // Ignore NULL bytes
+        if(c == '\0')
+            continue;
+
+        if(c == '\n' || c == '\r') {
+            y++;
+            x = 0;
+        } 
 
-    // If the scheduled terminal isn't the visible terminal, redirect VIDMEM to point to its backgroud buffer
-    if(visible_terminal != scheduled_terminal) {
-        if(!keyboard_flag){
-            // Note that we won't update the VGA blinking cursor here as it will spaz out the visible terminal
-            redirect_vidmem_page(scheduled_terminal);
-            screen_x = terminals[scheduled_terminal].cursor_x;  //update cursor coordinates
-            screen_y = terminals[scheduled_terminal].cursor_y;
-        }
-    }
+        // Backspace case to delete previous char 
+        else if(c == '\b') {
+            //do nothing if we're at (0,0)
+            if (x + y == 0)
+                continue;
+
+            // Set coordinates to previous index, going back to previous line if needed
+            x--;
+            if(x == -1) {
+                x = NUM_COLS - 1;
+                y--;
+            }
+
+            // Blank out previous char
+            row = y - (int32_t)(total_scrolls - scrolls);
+            if(screen != NULL && row >= 0)
+                *(uint16_t *)(screen + ((NUM_COLS * row + x) << 1)) = BLANK_CELL;
+        } 
 
-    if(c == '\n' || c == '\r') {
-        screen_y++;
-        screen_x = 0;
-        // If newline is entered while screen is filled, scroll up by one line
-        if(screen_y == NUM_ROWS) {
-            scroll();
-            screen_y = NUM_ROWS - 1;
-        }
-    } 
-    
-    // Backspace case to delete previous char 
-    else if(c == '\b') {
-        //do nothing if we're at (0,0)
-        if (screen_x + screen_y == 0)
-            return;
-
-        // Set coordinates to previous index
-        screen_x--;
-        
-        // Go back to previous line (screen_y) if needed
-        if(screen_x == -1) {
-            screen_x = NUM_COLS - 1;
-            screen_y--;
+        else {
+            row = y - (int32_t)(total_scrolls - scrolls);
+            if(screen != NULL && row >= 0)
+                *(uint16_t *)(screen + ((NUM_COLS * row + x) << 1)) = (ATTRIB << 8) | c;
+            x++;
+            if (x == NUM_COLS) {
+                x = 0;
+                y++;
+            }
         }
 
-        // Blank out previous char in vidmem
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = ' ';
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
-    } 
-    
-    else {
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = c;
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
-        screen_x++;
-        if (screen_x == NUM_COLS) {
-            screen_x = 0;
-            screen_y++;
+        // Past the bottom row, so the screen scrolls up by one line
+        if(y == NUM_ROWS) {
+            scrolls++;
+            y = NUM_ROWS - 1;
         }
-        // If screen gets filled after char gets printed, scroll up by one line
-        if(screen_y == NUM_ROWS) {
-            scroll();
-            screen_y = NUM_ROWS - 1;
-        } 
     }
 
-    // Update background terminal's cursor and restore the visible terminal's cursor and return
-    if(visible_terminal != scheduled_terminal) {
-        if(!keyboard_flag){
-            redirect_vidmem_page(visible_terminal);            // redirect virt_addr 0xB8000 to point back to itself
-            terminals[scheduled_terminal].cursor_x = screen_x; // save cursor to scheduled terminal
-            terminals[scheduled_terminal].cursor_y = screen_y;
-            screen_x = terminals[visible_terminal].cursor_x;  // restore visible cursor coordinates
-            screen_y = terminals[visible_terminal].cursor_y;
-            return;     // Return so that we don't spaz out the VGA blinking cursor
-        }
+    *cursor_x = x;
+    *cursor_y = y;
+    return scrolls;
+}
+
+/* int32_t write_screen(int32_t terminal_id, const int8_t* buf, int32_t n_bytes);
+ * Inputs: terminal_id = terminal to write to
+ *         buf = chars to print
+ *         n_bytes = number of chars in buf
+ * Return Value: number of chars consumed
+ *  Function: Renders a buffer into a terminal's text in one pass. Only a visible terminal's
+ *            writes touch VGA memory, and the blinking cursor is moved once at the end.
+ *            A write that spans N lines past the bottom scrolls once by N lines */
+int32_t write_screen(int32_t terminal_id, const int8_t* buf, int32_t n_bytes) {
+    uint32_t flags, scrolls;
+    char* screen;
+    int32_t x, y, end_x, end_y;
+
+    // Keep a terminal switch from moving the screen out from under us mid-write
+    cli_and_save(flags);
+
+    screen = terminal_screen(terminal_id);
+    if(terminal_id == visible_terminal) {
+        x = screen_x;
+        y = screen_y;
+    }
+    else {
+        x = terminals[terminal_id].cursor_x;
+        y = terminals[terminal_id].cursor_y;
     }
 
-    // Update cursor position
-    terminals[visible_terminal].cursor_x = screen_x;
-    terminals[visible_terminal].cursor_y = screen_y;
-    update_cursor(screen_x, screen_y);
+    // Find out how far the text scrolls, make room for all of it at once, then draw it
+    end_x = x;
+    end_y = y;
+    scrolls = render_text(NULL, &end_x, &end_y, buf, n_bytes, 0);
+    scroll(screen, scrolls);
+    (void)render_text(screen, &x, &y, buf, n_bytes, scrolls);
+    console_stats.chars += n_bytes;
+    console_stats.scrolls += scrolls ? 1 : 0;
+    console_stats.lines_scrolled += scrolls;
+
+    // Save the terminal's cursor, and move the blinking one only if it's on screen
+    terminals[terminal_id].cursor_x = x;
+    terminals[terminal_id].cursor_y = y;
+    if(terminal_id == visible_terminal)
+        update_cursor(x, y);
+
+    restore_flags(flags);
+    return n_bytes;
+}
+
+/* void putc(uint8_t c);
+ * Inputs: uint_8* c = character to print
+ *         int keyboard_flag = denotes whether or not this was called from keyboard
+ * Return Value: void
+ *  Function: Output a character to the console. Keyboard echo always goes to the visible
+ *            terminal, everything else to the terminal of the scheduled process */
+void putc(uint8_t c, int keyboard_flag) {
+    (void)write_screen(keyboard_flag ? visible_terminal : scheduled_terminal, (int8_t*)&c, 1);
 }
 
 /* int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
@@ -530,14 +590,23 @@ void* memmove(void* dest, const void* src, uint32_t n) {
     asm volatile ("                             \n\
             movw    %%ds, %%dx                  \n\
             movw    %%dx, %%es                  \n\
-            cld                                 \n\
             cmp     %%edi, %%esi                \n\
-            jae     .memmove_go                 \n\
+            jb      .memmove_back               \n\
+            cld                                 \n\
+            movl    %%ecx, %%edx                \n\
+            shrl    $2, %%ecx                   \n\
+            andl    $0x3, %%edx                 \n\
+            rep     movsl                       \n\
+            movl    %%edx, %%ecx                \n\
+            rep     movsb                       \n\
+            jmp     .memmove_done               \n\
+            .memmove_back:                      \n\
             leal    -1(%%esi, %%ecx), %%esi     \n\
             leal    -1(%%edi, %%ecx), %%edi     \n\
             std                                 \n\
-            .memmove_go:                        \n\
             rep     movsb                       \n\
+            cld                                 \n\
+            .memmove_done:                      \n\
             "
             :
             : "D"(dest), "S"(src), "c"(n)
@@ -11,10 +11,21 @@
 int32_t printf(int8_t *format, ...);
 void enable_cursor(void);               // Enables VGA text-mode cursor
 void update_cursor(int x, int y);       // Updates VGA text-mode cursor position
+void move_cursor(int32_t offset);       // Moves the visible cursor along the text by offset chars
 int get_screen_x();                     // Returns X-coordinate of screen
 int get_screen_y();                     // Returns Y-coordinate of screen 
-void scroll(void);                      // Scroll each line on screen up by one line
+void scroll(char* screen, int32_t lines);   // Scroll each line on screen up by lines
 void putc(uint8_t c, int keyboard_flag);
+int32_t write_screen(int32_t terminal_id, const int8_t* buf, int32_t n_bytes);  // Prints a buffer to a terminal
+
+// Console output counters (for benchmarking)
+typedef struct console_stats {
+    uint32_t chars;             // chars passed to write_screen
+    uint32_t scrolls;           // writes that scrolled the screen
+    uint32_t lines_scrolled;    // total lines those scrolls moved
+} console_stats_t;
+
+console_stats_t console_stats;
 int32_t puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
@@ -81,6 +92,36 @@ static inline uint32_t inl(port) {
     return val;
 }
 
+/* Reads the 64-bit time-stamp counter (EDX:EAX) for cycle-level timing */
+static inline uint64_t rdtsc(void) {
+    uint64_t val;
+    asm volatile ("rdtsc"
+            : "=A"(val)
+            :
+            : "memory"
+    );
+    return val;
+}
+
+/* Reads a 64-bit model-specific register */
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint64_t val;
+    asm volatile ("rdmsr"
+            : "=A"(val)
+            : "c"(msr)
+    );
+    return val;
+}
+
+/* Writes a 64-bit model-specific register */
+static inline void wrmsr(uint32_t msr, uint64_t val) {
+    asm volatile ("wrmsr"
+            :
+            : "c"(msr), "A"(val)
+            : "memory"
+    );
+}
+
 /* Writes a byte to a port */
 #define outb(data, port)                \
 do {                                    \
@@ -0,0 +1,108 @@
+/* memtype.c - Memory-type (caching) policy for page mappings
+ * vim:ts=4 noexpandtab
+ */
+
+/* A page's memory type comes from its PWT/PCD/PAT bits, which select one of eight entries in
+ * the PAT MSR. RAM gets write-back (PAT entry 0). VGA memory gets write-combining, which we put
+ * in PAT entry 1 in place of write-through (unused here), so it's selected with PWT=1, PCD=0.
+ * Device registers get strong uncached (entry 3).
+ * (https://wiki.osdev.org/Paging, Intel SDM Vol. 3 11.12)
+ */
+
+#include "memtype.h"
+#include "lib.h"
+
+#define CPUID_PAT (1 << 16)         // CPUID.01H:EDX bit for PAT support
+#define IA32_PAT 0x277
+#define PAT_WC 0x01                 // PAT encoding for write-combining
+#define PAT_ENTRY_1_SHIFT 8
+
+/*
+ * init_memtype
+ *    DESCRIPTION: Checks for a PAT and points PAT entry 1 at write-combining
+ *    INPUTS/OUTPUTS: none
+ *    SIDE EFFECTS: Writes IA32_PAT, must run before any WC mapping is used
+ */
+void init_memtype(void) {
+    uint32_t eax, ebx, ecx, edx;
+    uint64_t pat;
+
+    asm volatile ("cpuid"
+            : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+            : "a"(1)
+    );
+    memtype_has_pat = (edx & CPUID_PAT) != 0;
+    if(!memtype_has_pat)
+        return;
+
+    pat = rdmsr(IA32_PAT);
+    pat &= ~((uint64_t)0xFF << PAT_ENTRY_1_SHIFT);
+    pat |= (uint64_t)PAT_WC << PAT_ENTRY_1_SHIFT;
+    wrmsr(IA32_PAT, pat);
+    asm volatile ("wbinvd" ::: "memory");
+}
+
+/*
+ * memtype_of
+ *    DESCRIPTION: Picks the memory type for a mapping of a physical address
+ *    INPUTS: phys_addr -- physical address being mapped
+ *    RETURNS: MEM_WC for VGA memory, MEM_UC for the rest of the ROM/BIOS hole, MEM_WB for RAM
+ */
+uint32_t memtype_of(uint32_t phys_addr) {
+    if(phys_addr >= VGA_WINDOW_START && phys_addr < VGA_WINDOW_END)
+        return MEM_WC;
+    if(phys_addr >= VGA_WINDOW_END && phys_addr < BIOS_AREA_END)
+        return MEM_UC;
+    return MEM_WB;
+}
+
+/*
+ * memtype_set_pte
+ *    DESCRIPTION: Sets the caching bits of a 4KB page table entry
+ *    INPUTS: entry -- page table entry to update
+ *            type -- one of the MEM_* types
+ *    RETURNS: none
+ *    NOTES: Without a PAT, WC falls back to UC- (PCD=1, PWT=0), which an MTRR can still make WC
+ */
+void memtype_set_pte(page_tab_desc_t* entry, uint32_t type) {
+    entry->page_attr_tab_index = 0;
+    switch(type) {
+        case MEM_WC:
+            entry->page_write_through = memtype_has_pat;
+            entry->page_cache_disabled = !memtype_has_pat;
+            break;
+        case MEM_UC:
+            entry->page_write_through = 1;
+            entry->page_cache_disabled = 1;
+            break;
+        default:
+            entry->page_write_through = 0;
+            entry->page_cache_disabled = 0;
+            break;
+    }
+}
+
+/*
+ * memtype_set_pde
+ *    DESCRIPTION: Sets the caching bits of a 4MB page directory entry
+ *    INPUTS: entry -- page directory entry to update
+ *            type -- one of the MEM_* types
+ *    RETURNS: none
+ */
+void memtype_set_pde(page_dir_desc_t* entry, uint32_t type) {
+    entry->pd_mb.page_attr_index = 0;
+    switch(type) {
+        case MEM_WC:
+            entry->pd_mb.page_write_through = memtype_has_pat;
+            entry->pd_mb.page_cache_disabled = !memtype_has_pat;
+            break;
+        case MEM_UC:
+            entry->pd_mb.page_write_through = 1;
+            entry->pd_mb.page_cache_disabled = 1;
+            break;
+        default:
+            entry->pd_mb.page_write_through = 0;
+            entry->pd_mb.page_cache_disabled = 0;
+            break;
+    }
+}
@@ -0,0 +1,37 @@
+/* memtype.h - Memory-type (caching) policy for page mappings
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _MEMTYPE_H
+#define _MEMTYPE_H
+
+#include "types.h"
+#include "x86_desc.h"
+
+// Memory types a mapping can ask for
+#define MEM_WB 0        // write-back, for anything backed by RAM
+#define MEM_WC 1        // write-combining, for frame buffers (uncached when there's no PAT)
+#define MEM_UC 2        // strong uncached, for memory-mapped device registers
+
+// Legacy VGA window, the only device memory this kernel maps
+#define VGA_WINDOW_START 0xA0000
+#define VGA_WINDOW_END 0xC0000
+// Option ROMs and BIOS, uncached until the first megabyte ends
+#define BIOS_AREA_END 0x100000
+
+// Set if the CPU has a PAT, so write-combining can be selected per page
+uint32_t memtype_has_pat;
+
+// Detects the PAT and reprograms it so a page can select write-combining
+extern void init_memtype(void);
+
+// Memory type to use for a mapping of the given physical address
+extern uint32_t memtype_of(uint32_t phys_addr);
+
+// Sets the caching bits of a 4KB page table entry
+extern void memtype_set_pte(page_tab_desc_t* entry, uint32_t type);
+
+// Sets the caching bits of a 4MB page directory entry
+extern void memtype_set_pde(page_dir_desc_t* entry, uint32_t type);
+
+#endif /* _MEMTYPE_H */
@@ -10,6 +10,11 @@
 #define MULTIBOOT_HEADER_MAGIC          0x1BADB002
 #define MULTIBOOT_BOOTLOADER_MAGIC      0x2BADB002
 
+/* Bits of multiboot_info_t.flags */
+#define MULTIBOOT_INFO_MEMORY           0x00000001  /* mem_lower and mem_upper are valid */
+#define MULTIBOOT_INFO_MODS             0x00000008  /* mods_count and mods_addr are valid */
+#define MULTIBOOT_INFO_MMAP             0x00000040  /* mmap_length and mmap_addr are valid */
+
 #ifndef ASM
 
 /* Types */
@@ -14,6 +14,33 @@
 #include "paging.h"
 #include "lib.h"
 #include "terminal.h"
+#include "system_calls.h"
+#include "file_system.h"
+#include "image_cache.h"
+#include "frames.h"
+#include "tlb.h"
+#include "memtype.h"
+#include "scheduler.h"
+
+/* The per-process tables below are frames from the frame pool, taken when a process with the
+   PID first needs them (see alloc_process_tables) and given back when it's reaped */
+
+// One page table per process that splits its 4MB program page into 4KB pages
+static page_tab_desc_t* user_prog_tables[MAX_PIDS];
+
+// One page table per process for the files it has mapped, see mmap_file
+static page_tab_desc_t* user_mmap_tables[MAX_PIDS];
+
+// One page directory per process. Kernel entries are copied from page_directory, which stays the template
+static page_dir_desc_t* process_dirs[MAX_PIDS];
+
+// (MP3.4) One user video page table per terminal, so vidmap'd pages follow their terminal without remapping
+static page_tab_desc_t user_video_tables[MAX_TERMINALS][ONE_KB] __attribute__((aligned (FOUR_KB)));
+
+// Process whose page directory is loaded in CR3 (-1 while the boot-time template is still loaded)
+static int32_t active_dir_pid = -1;
+
+static void point_user_video_table(int32_t terminal_id);
 
 /* NOTES: Kernel already loaded at FOUR_MB and should be a single 4MB page.
           VidMem already loaded at VIDEO (see paging.h) and should be a single 4KB page.
@@ -28,7 +55,10 @@
  */
 void init_paging() {
     
-    int i;
+    int i, j;
+
+    // Caching bits below come from the memory-type policy, which needs to know if there's a PAT
+    init_memtype();
 
     for(i=0;i < ONE_KB;i++){
         //fill all of directory w/ blank pages b/c unused
@@ -63,12 +93,15 @@ void init_paging() {
         page.avail = 0;
         page.page_base_address = i;
 
-        // Place blank entry in user video table (placed here to avoid next if case)
-        user_video_table[i] = page;
+        // Place blank entry in user video tables (placed here to avoid next if case)
+        for(j = 0; j < MAX_TERMINALS; j++)
+            user_video_tables[j][i] = page;
         
         // Mark page table entries for kernel vidmem and the 3 terminals as present
         if(i >= VIDMEM_PAGE_BASE && i <= VIDMEM_PAGE_BASE + 3) {
             page.present = 1;   
+            page.global_bit = 1;    // same in every address space
+            memtype_set_pte(&page, memtype_of(i << 12));    // VGA memory is write-combined
         }   
         
         // Place entry in kernel video memory page table 
@@ -80,7 +113,7 @@ void init_paging() {
     page_directory[0].pd_kb.read_write = 1;     //all pages are marked read/write for mp3
     page_directory[0].pd_kb.user_supervisor = 0;    //0 for kernel pages
     page_directory[0].pd_kb.page_write_through = 0; //we always want writeback, so 0
-    page_directory[0].pd_kb.page_cache_disabled = 0; //0 for video memory pages
+    page_directory[0].pd_kb.page_cache_disabled = 0; //0 b/c the page table itself is in RAM
     page_directory[0].pd_kb.accessed = 0;   //not used at all in mp3
     page_directory[0].pd_kb.reserved = 0;   //all reserved bits should be set to 0
     page_directory[0].pd_kb.page_size = 0;  //0 if 4K page directory entry
@@ -92,8 +125,7 @@ void init_paging() {
     page_directory[1].pd_mb.present = 1;    //present b/c page is being initialized
     page_directory[1].pd_mb.read_write = 1;     //all pages are marked read/write for mp3
     page_directory[1].pd_mb.user_supervisor = 0;    //0 for kernel pages
-    page_directory[1].pd_mb.page_write_through = 0;    //we always want writeback, so 0
-    page_directory[1].pd_mb.page_cache_disabled = 1;    //1 for program code and data pages (kernel pages)
+    memtype_set_pde(&page_directory[1], memtype_of(FOUR_MB));  //kernel code and data are RAM, so write-back
     page_directory[1].pd_mb.accessed = 0;   //not used at all in mp3
     page_directory[1].pd_mb.dirty = 0;      //not used at all in mp3
     page_directory[1].pd_mb.page_size = 1;  //1 if 4M page directory entry
@@ -119,18 +151,25 @@ void init_paging() {
         page_directory[i].pd_mb.base_addr = i;
     }       
 
-    /* Flush the TLB as we've made changes to the paging structure */
-    flush_tlb();
+    // Each terminal's user video page is always mapped, it just points at VGA or a background buffer
+    for(j = 0; j < MAX_TERMINALS; j++) {
+        user_video_tables[j][0].present = 1;
+        memtype_set_pte(&user_video_tables[j][0], memtype_of(VIDMEM));
+        point_user_video_table(j);
+    }
 
     // Load and enable page directory address in register CR3
     asm volatile ("movl  %0, %%eax;"                //loads page directory
                   "movl %%eax, %%cr3;"
                   "movl %%cr4, %%eax;"              
-                  "orl $0x00000010, %%eax;"         
+                  "orl $0x00000010, %%eax;"         //PSE for 4MB pages
                   "movl %%eax, %%cr4;"
                   "movl %%cr0, %%eax;"              //enables page directory
-                  "orl $0x80000000, %%eax;"
+                  "orl $0x80010000, %%eax;"         //also sets WP so the kernel honors read-only user pages
                   "movl %%eax, %%cr0;"
+                  "movl %%cr4, %%eax;"
+                  "orl $0x00000080, %%eax;"         //PGE so global (kernel) pages survive CR3 loads
+                  "movl %%eax, %%cr4;"
                 :                                   // no outputs
                 : "r" (page_directory)              // input: page_directory
                 : "eax", "cc"        // clobbers eax and condition codes
@@ -139,29 +178,486 @@ void init_paging() {
 }
 
 /*  
- * set_user_prog_page
- *    DESCRIPTION: Re-maps the user program page for the process with pid
+ * map_kernel_page
+ *    DESCRIPTION: Identity maps a 4MB page that only the kernel can touch
+ *    INPUTS: dir_i -- page directory index, the page covers physmem [dir_i * 4MB, (dir_i + 1) * 4MB)
+ *    RETURNS: none  
+ *    SIDE EFFECTS: Marks the page directory entry present and flushes the TLB (global entries too)
+ *    NOTES: Used for kernel-owned memory beyond the kernel page (e.g. the image cache)
+ */
+void map_kernel_page(uint32_t dir_i) {
+    page_directory[dir_i].pd_mb.present = 1;
+    page_directory[dir_i].pd_mb.read_write = 1;
+    page_directory[dir_i].pd_mb.user_supervisor = 0;    //0 for kernel pages
+    memtype_set_pde(&page_directory[dir_i], memtype_of(dir_i * FOUR_MB));
+    page_directory[dir_i].pd_mb.accessed = 0;
+    page_directory[dir_i].pd_mb.dirty = 0;
+    page_directory[dir_i].pd_mb.page_size = 1;  //1 if 4M page directory entry
+    page_directory[dir_i].pd_mb.global_bit = 1; // mapped the same way in every address space
+    page_directory[dir_i].pd_mb.available = 0;
+    page_directory[dir_i].pd_mb.page_attr_index = 0;
+    page_directory[dir_i].pd_mb.reserved = 0;
+    page_directory[dir_i].pd_mb.base_addr = dir_i;
+    tlb_flush_global();
+}
+
+/*  
+ * alloc_process_tables
+ *    DESCRIPTION: Makes sure a PID has its page directory and page tables
  *    INPUTS: pid -- ID of process
- *            present_flag -- set to 0 to mark page not present, 1 to mark as present
+ *    RETURNS: 0 on success, -1 if the frame pool ran out
+ *    SIDE EFFECTS: Missing tables are allocated from the frame pool and zeroed
+ */
+static int32_t alloc_process_tables(uint32_t pid) {
+    if(user_prog_tables[pid] == NULL) {
+        user_prog_tables[pid] = (page_tab_desc_t*)frame_alloc();
+        if(user_prog_tables[pid] == NULL)
+            return -1;
+        memset(user_prog_tables[pid], 0, FOUR_KB);
+    }
+    if(user_mmap_tables[pid] == NULL) {
+        user_mmap_tables[pid] = (page_tab_desc_t*)frame_alloc();
+        if(user_mmap_tables[pid] == NULL)
+            return -1;
+        memset(user_mmap_tables[pid], 0, FOUR_KB);
+    }
+    if(process_dirs[pid] == NULL) {
+        process_dirs[pid] = (page_dir_desc_t*)frame_alloc();
+        if(process_dirs[pid] == NULL)
+            return -1;
+    }
+    return 0;
+}
+
+/*  
+ * free_process_tables
+ *    DESCRIPTION: Gives a PID's page directory and page tables back to the frame pool
+ *    INPUTS: pid -- ID of a process that is being reaped
  *    RETURNS: none  
- *    SIDE EFFECTS: Maps user program page (virtual addr 128MB) to PhysMem
- *    NOTES: 
+ *    SIDE EFFECTS: Drops whatever the tables still map first
+ *    NOTES: The directory must not be loaded in CR3 anymore
+ */
+void free_process_tables(uint32_t pid) {
+    release_user_prog_table(pid);
+    release_user_mmap_table(pid);
+    frame_put((uint32_t)user_prog_tables[pid]);
+    frame_put((uint32_t)user_mmap_tables[pid]);
+    frame_put((uint32_t)process_dirs[pid]);
+    user_prog_tables[pid] = NULL;
+    user_mmap_tables[pid] = NULL;
+    process_dirs[pid] = NULL;
+    if(active_dir_pid == (int32_t)pid)
+        active_dir_pid = -1;
+}
+
+/*  
+ * init_process_dir
+ *    DESCRIPTION: Builds the page directory for the process with pid
+ *    INPUTS: pid -- ID of process
+ *            terminal_id -- terminal the process runs in (picks its user video page table)
+ *    RETURNS: 0 on success, -1 if there was no frame for the directory or its tables
+ *    SIDE EFFECTS: Copies the kernel mappings from the template directory and points the
+ *                  user program page (virt addr 128MB) and mmap area (132MB) at the process's
+ *                  4KB page tables
+ *    NOTES: The user video page stays not present until the process calls vidmap
+ */
+int32_t init_process_dir(uint32_t pid, int32_t terminal_id) {
+    page_dir_desc_t *dir;
+
+    if(alloc_process_tables(pid) == -1)
+        return -1;
+    dir = process_dirs[pid];
+
+    memcpy(dir, page_directory, ONE_KB * sizeof(page_dir_desc_t));
+
+    dir[USER_PAGE_BASE_ADDR].pd_kb.val = 0;
+    dir[USER_PAGE_BASE_ADDR].pd_kb.present = 1;
+    dir[USER_PAGE_BASE_ADDR].pd_kb.read_write = 1;     //all pages are marked read/write for mp3
+    dir[USER_PAGE_BASE_ADDR].pd_kb.user_supervisor = 1;    //1 for user pages
+    dir[USER_PAGE_BASE_ADDR].pd_kb.page_size = 0;  //0 if 4K page directory entry
+    dir[USER_PAGE_BASE_ADDR].pd_kb.page_table_addr = (unsigned)user_prog_tables[pid] >> 12; //shift address of table for 4KB align
+
+    dir[USER_MMAP_DIR_I].pd_kb.val = 0;
+    dir[USER_MMAP_DIR_I].pd_kb.present = 1;
+    dir[USER_MMAP_DIR_I].pd_kb.read_write = 1;     //each page table entry decides, mmap pages are read-only
+    dir[USER_MMAP_DIR_I].pd_kb.user_supervisor = 1;
+    dir[USER_MMAP_DIR_I].pd_kb.page_size = 0;  //0 if 4K page directory entry
+    dir[USER_MMAP_DIR_I].pd_kb.page_table_addr = (unsigned)user_mmap_tables[pid] >> 12;
+
+    dir[USER_VID_PAGE_DIR_I].pd_kb.val = 0;
+    dir[USER_VID_PAGE_DIR_I].pd_kb.read_write = 1;
+    dir[USER_VID_PAGE_DIR_I].pd_kb.user_supervisor = 1;    //1 for user-level pages
+    dir[USER_VID_PAGE_DIR_I].pd_kb.page_size = 0;  //0 if 4K page directory entry
+    dir[USER_VID_PAGE_DIR_I].pd_kb.page_table_addr = (unsigned)user_video_tables[terminal_id] >> 12;
+    return 0;
+}
+
+/*  
+ * switch_page_directory
+ *    DESCRIPTION: Makes the process with pid's page directory the active one
+ *    INPUTS: pid -- ID of process
+ *    RETURNS: none  
+ *    SIDE EFFECTS: Loads CR3, which drops the TLB entries of the old process but keeps the kernel's
+ */
+void switch_page_directory(uint32_t pid) {
+    active_dir_pid = pid;
+    tlb_switch_directory(process_dirs[pid]);
+}
+
+/*  
+ * init_user_prog_table
+ *    DESCRIPTION: Empties a process's program page table so every 4KB page is mapped on first touch
+ *    INPUTS: pid -- ID of process whose image is being replaced
+ *    RETURNS: 0 on success, -1 if the PID has no page tables and the frame pool is empty
+ *    SIDE EFFECTS: Drops the references held by any entries that are still mapped
+ *    NOTES: Called by execute() before the program page is mapped in
+ */
+int32_t init_user_prog_table(uint32_t pid) {
+    if(alloc_process_tables(pid) == -1)
+        return -1;
+    release_user_prog_table(pid);
+    return 0;
+}
+
+/*  
+ * release_user_prog_table
+ *    DESCRIPTION: Unmaps every page of a process's program page and gives back its frames
+ *    INPUTS: pid -- ID of process
+ *    RETURNS: none  
+ *    SIDE EFFECTS: Shared frames lose one reference, private frames go back to the frame pool
+ *    NOTES: The caller remaps (and flushes) the program page afterwards
  */
-void set_user_prog_page(uint32_t pid, int32_t present_flag) {
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.present = present_flag;
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.read_write = 1;     //all pages are marked read/write for mp3
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.user_supervisor = 1;    //1 for user pages
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.page_write_through = 0;    //we always want writeback, so 0
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.page_cache_disabled = 1;    //1 for program code and data pages (kernel pages)
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.accessed = 0;   //not used at all in mp3
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.dirty = 0;      //not used at all in mp3
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.page_size = 1;  //1 if 4M page directory entry
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.global_bit = 0; // user page should not be global
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.available = 0;  //not used at all in mp3
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.page_attr_index = 0;  //not used at all in mp3
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.reserved = 0;       //reserved bits are always set to 0
-    page_directory[USER_PAGE_BASE_ADDR].pd_mb.base_addr = 2 + pid;     // Map physmem [8MB + (pid * 4MB)] as mult of 4MB
-    flush_tlb();
+void release_user_prog_table(uint32_t pid) {
+    int i;
+    if(user_prog_tables[pid] == NULL)
+        return;
+    for(i = 0; i < ONE_KB; i++) {
+        if(user_prog_tables[pid][i].present)
+            frame_put(user_prog_tables[pid][i].page_base_address << 12);
+        user_prog_tables[pid][i].val = 0;
+    }
+}
+
+/*  
+ * map_prog_page
+ *    DESCRIPTION: Maps one 4KB page of a process's program page
+ *    INPUTS: pid -- ID of process that owns the page table
+ *            pcb -- that process's PCB (says which executable backs the image)
+ *            page_i -- index of the 4KB page within the 4MB program page
+ *    RETURNS: 0 on success, -1 if no frame was available
+ *    SIDE EFFECTS: Pages of a cached image are mapped read-only straight onto the cache so every
+ *                  process running the same program shares them. Everything else gets a private
+ *                  frame filled from the executable, or zeros if it lies outside the file (stack, bss)
+ *    NOTES: The image is linked at PROG_IMG_ADDR, so file offset f lives at PROG_IMG_ADDR + f
+ */
+static int32_t map_prog_page(uint32_t pid, pcb_t* pcb, uint32_t page_i) {
+    page_tab_desc_t *entry = &user_prog_tables[pid][page_i];
+    uint32_t page_addr = ONE_TWO_EIGHT_MB + (page_i << 12);
+    uint32_t file_backed = (page_addr >= PROG_IMG_ADDR && page_addr - PROG_IMG_ADDR < pcb->exec_size);
+    uint32_t frame, bytes_loaded = 0;
+
+    entry->val = 0;
+    entry->user_supervisor = 1;     //1 for user pages
+
+#ifdef USE_IMAGE_CACHE
+    if(file_backed && pcb->exec_image != NULL) {
+        uint64_t start = rdtsc();
+
+        // Share the pristine cached page, the first write to it makes a private copy
+        entry->page_base_address = ((uint32_t)pcb->exec_image->image + (page_addr - PROG_IMG_ADDR)) >> 12;
+        memtype_set_pte(entry, memtype_of(entry->page_base_address << 12));
+        entry->read_write = 0;
+        entry->avail = PTE_AVAIL_COW;
+        entry->present = 1;
+        cow_stats.shared_maps++;
+        image_cache_stats.hit_cycles += (uint32_t)(rdtsc() - start);
+        return 0;
+    }
+#endif
+
+    frame = frame_alloc();
+    if(frame == 0)
+        return -1;
+    if(file_backed)
+        bytes_loaded = read_data(pcb->exec_inode, page_addr - PROG_IMG_ADDR, (uint8_t*)frame, FOUR_KB);
+    if(bytes_loaded < FOUR_KB)
+        memset((void*)(frame + bytes_loaded), 0, FOUR_KB - bytes_loaded);
+
+    entry->page_base_address = frame >> 12;
+    memtype_set_pte(entry, memtype_of(frame));
+    entry->read_write = 1;
+    entry->present = 1;
+    return 0;
+}
+
+/*  
+ * populate_user_prog_image
+ *    DESCRIPTION: Maps every page of the executable up front (eager loading)
+ *    INPUTS: pid -- ID of process that owns the page table
+ *            pcb -- that process's PCB
+ *    RETURNS: 0 on success, -1 if frames ran out
+ *    SIDE EFFECTS: Pages outside the image (stack, bss) are still mapped on first touch
+ */
+int32_t populate_user_prog_image(uint32_t pid, pcb_t* pcb) {
+    uint32_t page_i = (PROG_IMG_ADDR - ONE_TWO_EIGHT_MB) >> 12;
+    uint32_t end_i = (PROG_IMG_ADDR - ONE_TWO_EIGHT_MB + pcb->exec_size + FOUR_KB - 1) >> 12;
+
+    for(; page_i < end_i && page_i < ONE_KB; page_i++) {
+        if(map_prog_page(pid, pcb, page_i) == -1)
+            return -1;
+    }
+    // Every entry was not present before, so there are no stale translations to flush
+    return 0;
+}
+
+/*  
+ * demand_load_page
+ *    DESCRIPTION: Resolves a not-present fault inside the user program page
+ *    INPUTS: fault_addr -- linear address that faulted (CR2)
+ *    RETURNS: 0 if the page was mapped and the access can be retried, -1 otherwise
+ *    SIDE EFFECTS: Maps the 4KB page containing fault_addr, see map_prog_page
+ */
+int32_t demand_load_page(uint32_t fault_addr) {
+    uint64_t start = rdtsc();
+    pcb_t *pcb = current_pcb;
+
+    // Only the user program page is demand loaded
+    if(fault_addr < ONE_TWO_EIGHT_MB || fault_addr >= ONE_THREE_TWO_MB)
+        return -1;
+
+    uint32_t page_i = (fault_addr - ONE_TWO_EIGHT_MB) >> 12;
+    if(user_prog_tables[pcb->process_id][page_i].present)
+        return -1;
+
+    if(map_prog_page(pcb->process_id, pcb, page_i) == -1)
+        return -1;
+    tlb_flush_page(fault_addr);
+
+    demand_page_faults++;
+    demand_page_cycles += (uint32_t)(rdtsc() - start);
+    return 0;
+}
+
+/*  
+ * cow_fault
+ *    DESCRIPTION: Resolves a write to a shared, read-only page of the user program page
+ *    INPUTS: fault_addr -- linear address that faulted (CR2)
+ *    RETURNS: 0 if the page is now writable and the access can be retried, -1 otherwise
+ *    SIDE EFFECTS: Copies the page into a private frame, or just makes it writable if this
+ *                  process holds the only reference to a pool frame
+ *    NOTES: CR0.WP is set, so kernel writes into user buffers end up here too
+ */
+int32_t cow_fault(uint32_t fault_addr) {
+    pcb_t *pcb = current_pcb;
+
+    if(fault_addr < ONE_TWO_EIGHT_MB || fault_addr >= ONE_THREE_TWO_MB)
+        return -1;
+
+    page_tab_desc_t *entry = &user_prog_tables[pcb->process_id][(fault_addr - ONE_TWO_EIGHT_MB) >> 12];
+    if(!entry->present || !(entry->avail & PTE_AVAIL_COW))
+        return -1;
+
+    uint32_t old_frame = entry->page_base_address << 12;
+    if(frame_refcount(old_frame) == 1) {
+        // Last user of a pool frame, nobody left to share it with
+        cow_stats.reuses++;
+    }
+    else {
+        uint32_t new_frame = frame_alloc();
+        if(new_frame == 0)
+            return -1;
+        memcpy((void*)new_frame, (void*)old_frame, FOUR_KB);   // both frames are identity mapped for the kernel
+        entry->page_base_address = new_frame >> 12;
+        frame_put(old_frame);
+        cow_stats.copies++;
+    }
+    entry->read_write = 1;
+    entry->avail &= ~PTE_AVAIL_COW;
+    tlb_flush_page(fault_addr);
+    return 0;
+}
+
+/*  
+ * fork_user_pages
+ *    DESCRIPTION: Gives a forked child the same user address space as its parent, sharing every
+ *                 frame copy-on-write instead of copying it
+ *    INPUTS: parent_pid -- ID of the running process that called fork
+ *            child_pid -- ID of the new process
+ *            terminal_id -- terminal the child runs in
+ *    RETURNS: 0 on success, -1 if there were no frames for the child's directory and tables
+ *    SIDE EFFECTS: Writable program pages turn read-only and copy-on-write in both processes, so
+ *                  whichever writes first gets its own copy (cow_fault). Read-only pages (cached
+ *                  image pages, mmaps) are shared as they are. Every shared frame gains a reference
+ *    NOTES: Flushes the TLB, so call it with the parent's page directory loaded
+ */
+int32_t fork_user_pages(uint32_t parent_pid, uint32_t child_pid, int32_t terminal_id) {
+    page_tab_desc_t *parent_table, *child_table;
+    uint32_t i;
+
+    if(init_user_prog_table(child_pid) == -1 || init_process_dir(child_pid, terminal_id) == -1)
+        return -1;
+
+    parent_table = user_prog_tables[parent_pid];
+    child_table = user_prog_tables[child_pid];
+    for(i = 0; i < ONE_KB; i++) {
+        if(!parent_table[i].present)
+            continue;
+        if(parent_table[i].read_write) {
+            parent_table[i].read_write = 0;
+            parent_table[i].avail |= PTE_AVAIL_COW;
+        }
+        child_table[i] = parent_table[i];
+        frame_get(parent_table[i].page_base_address << 12);    // no-op for cached image pages
+        cow_stats.shared_maps++;
+    }
+
+    parent_table = user_mmap_tables[parent_pid];
+    child_table = user_mmap_tables[child_pid];
+    for(i = 0; i < ONE_KB; i++) {
+        child_table[i] = parent_table[i];
+        if(parent_table[i].present)
+            frame_get(parent_table[i].page_base_address << 12);    // no-op for blocks mapped in place
+    }
+
+    // A parent that called vidmap keeps its video page in the child too
+    process_dirs[child_pid][USER_VID_PAGE_DIR_I].pd_kb.present =
+        process_dirs[parent_pid][USER_VID_PAGE_DIR_I].pd_kb.present;
+
+    // The parent's writable pages just went read-only
+    tlb_flush_all();
+    return 0;
+}
+
+/*  
+ * mmap_file
+ *    DESCRIPTION: Maps a whole file read-only into a process's mmap area, one page per data block
+ *    INPUTS: pid -- ID of process
+ *            inode -- inode of the file
+ *    RETURNS: User address of the first byte of the file, 0 if the file is empty, its inode is
+ *             bad, the mmap area has no run of free pages long enough, or frames ran out
+ *    SIDE EFFECTS: Blocks are 4KB, so a page-aligned block is mapped in place and nothing is
+ *                  copied. A block that isn't (the boot module wasn't loaded page-aligned) is
+ *                  copied into a frame instead, so the file still shows up contiguous
+ *    NOTES: The bytes after the end of the file in its last page are whatever its block holds
+ */
+uint32_t mmap_file(uint32_t pid, uint32_t inode) {
+    page_tab_desc_t *table = user_mmap_tables[pid];
+    uint32_t npages, first, run, i, block, block_addr, frame;
+
+    if(inode >= boot->num_inodes)
+        return 0;
+    npages = (fs_inode[inode].file_size + FOUR_KB - 1) >> 12;
+    if(npages == 0 || npages > ONE_KB)
+        return 0;
+
+    // First fit
+    for(first = 0, run = 0; first + run < ONE_KB && run < npages; ) {
+        if(table[first + run].present) {
+            first += run + 1;
+            run = 0;
+        }
+        else
+            run++;
+    }
+    if(run < npages)
+        return 0;
+
+    for(i = 0; i < npages; i++) {
+        page_tab_desc_t *entry = &table[first + i];
+
+        block = fs_inode[inode].index_num[i];
+        if(block >= boot->num_data_blocks)
+            break;
+        block_addr = (uint32_t)&fs_data_block[block];
+
+        if((block_addr & (FOUR_KB - 1)) == 0) {
+            frame = block_addr;
+            mmap_stats.direct_pages++;
+        }
+        else {
+            frame = frame_alloc();
+            if(frame == 0)
+                break;
+            memcpy((void*)frame, (void*)block_addr, BLOCK_SIZE);
+            mmap_stats.copied_pages++;
+        }
+
+        entry->val = 0;
+        entry->user_supervisor = 1;     //1 for user pages
+        entry->read_write = 0;
+        entry->page_base_address = frame >> 12;
+        memtype_set_pte(entry, memtype_of(frame));
+        entry->avail = (i + 1 < npages) ? PTE_AVAIL_MMAP_CONT : 0;
+        entry->present = 1;
+    }
+
+    // Back out of a half-built mapping, none of it was ever visible so nothing needs flushing
+    if(i < npages) {
+        while(i-- > 0) {
+            frame_put(table[first + i].page_base_address << 12);   // no-op for blocks mapped in place
+            table[first + i].val = 0;
+        }
+        return 0;
+    }
+
+    mmap_stats.maps++;
+    return USER_MMAP_ADDR + (first << 12);
+}
+
+/*  
+ * munmap_pages
+ *    DESCRIPTION: Removes a mapping made by mmap_file
+ *    INPUTS: pid -- ID of process
+ *            addr -- user address mmap_file returned
+ *    RETURNS: 0 on success, -1 if no mapping starts at addr
+ *    SIDE EFFECTS: Copied pages go back to the frame pool
+ *    NOTES: Flushes the TLB, so call it with pid's page directory loaded
+ */
+int32_t munmap_pages(uint32_t pid, uint32_t addr) {
+    page_tab_desc_t *table = user_mmap_tables[pid];
+    uint32_t page_i, cont, npages = 0;
+
+    if(addr < USER_MMAP_ADDR || addr >= USER_MMAP_ADDR + FOUR_MB || (addr & (FOUR_KB - 1)) != 0)
+        return -1;
+    page_i = (addr - USER_MMAP_ADDR) >> 12;
+
+    // Has to be the first page of a mapping, not one in the middle
+    if(!table[page_i].present ||
+       (page_i > 0 && table[page_i - 1].present && (table[page_i - 1].avail & PTE_AVAIL_MMAP_CONT)))
+        return -1;
+
+    do {
+        cont = table[page_i].avail & PTE_AVAIL_MMAP_CONT;
+        frame_put(table[page_i].page_base_address << 12);      // no-op for blocks mapped in place
+        table[page_i].val = 0;
+        if(npages < MMAP_FLUSH_ALL_PAGES)
+            tlb_flush_page(USER_MMAP_ADDR + (page_i << 12));
+        page_i++;
+        npages++;
+    } while(cont && page_i < ONE_KB);
+
+    if(npages > MMAP_FLUSH_ALL_PAGES)
+        tlb_flush_all();
+    return 0;
+}
+
+/*  
+ * release_user_mmap_table
+ *    DESCRIPTION: Drops every file a process has mapped
+ *    INPUTS: pid -- ID of process
+ *    RETURNS: none  
+ *    NOTES: For halt and execute, which drop (or replace) the whole address space anyway,
+ *           so the TLB is left to the next CR3 load
+ */
+void release_user_mmap_table(uint32_t pid) {
+    int i;
+    if(user_mmap_tables[pid] == NULL)
+        return;
+    for(i = 0; i < ONE_KB; i++) {
+        if(user_mmap_tables[pid][i].present)
+            frame_put(user_mmap_tables[pid][i].page_base_address << 12);
+        user_mmap_tables[pid][i].val = 0;
+    }
 }
 
 /*  
@@ -169,30 +665,31 @@ void set_user_prog_page(uint32_t pid, int32_t present_flag) {
  *    DESCRIPTION: Sets up page for user to interact with video memory
  *    INPUTS: present_flag -- set to 0 to mark page not present, 1 to mark as present
  *    RETURNS: none  
- *    SIDE EFFECTS: Configures user video page at virt addr 256MB
- *    NOTES: 
+ *    SIDE EFFECTS: Configures user video page at virt addr 256MB in the running process's directory
+ *    NOTES: The page table behind it belongs to the process's terminal, see init_process_dir
  */
 void set_user_video_page(int32_t present_flag) {
-    user_video_table[0].present = present_flag;            // Mark table entry as present
-    
-    // Check if vidmap should be writing to screen or to background 
-    if(visible_terminal == scheduled_terminal)
-        user_video_table[0].page_base_address = VIDMEM_PAGE_BASE;  // Set page to point to physical video memory
+    // The boot-time template never maps user video memory
+    if(active_dir_pid < 0)
+        return;
+
+    process_dirs[active_dir_pid][USER_VID_PAGE_DIR_I].pd_kb.present = present_flag;
+    tlb_flush_page(TWO_FIVE_SIX_MB);
+}
+
+/*  
+ * point_user_video_table
+ *    DESCRIPTION: Points a terminal's user video page at VGA memory if the terminal is visible,
+ *                 or at its background buffer if it isn't
+ *    INPUTS: terminal_id -- terminal whose user video page table to update
+ *    RETURNS: none  
+ *    NOTES: Caller flushes the TLB
+ */
+static void point_user_video_table(int32_t terminal_id) {
+    if(terminal_id == visible_terminal)
+        user_video_tables[terminal_id][0].page_base_address = VIDMEM_PAGE_BASE;  // Set page to point to physical video memory
     else
-        user_video_table[0].page_base_address = VIDMEM_PAGE_BASE + scheduled_terminal + 1; // Set page to background 
-    
-    page_directory[USER_VID_PAGE_DIR_I].pd_kb.present = present_flag;        //present b/c page is being initialized
-    page_directory[USER_VID_PAGE_DIR_I].pd_kb.read_write = 1;     //all pages are marked read/write for mp3
-    page_directory[USER_VID_PAGE_DIR_I].pd_kb.user_supervisor = 1;    //1 for user-level pages
-    page_directory[USER_VID_PAGE_DIR_I].pd_kb.page_write_through = 0; //we always want writeback, so 0
-    page_directory[USER_VID_PAGE_DIR_I].pd_kb.page_cache_disabled = 0; //0 for video memory pages
-    page_directory[USER_VID_PAGE_DIR_I].pd_kb.accessed = 0;   //not used at all in mp3
-    page_directory[USER_VID_PAGE_DIR_I].pd_kb.reserved = 0;   //all reserved bits should be set to 0
-    page_directory[USER_VID_PAGE_DIR_I].pd_kb.page_size = 0;  //0 if 4K page directory entry
-    page_directory[USER_VID_PAGE_DIR_I].pd_kb.global_bit = 0; //0 b/c not kernel page
-    page_directory[USER_VID_PAGE_DIR_I].pd_kb.available = 0;  //not used at all in mp3
-    page_directory[USER_VID_PAGE_DIR_I].pd_kb.page_table_addr = (unsigned)user_video_table >> 12; //shift address of table for 4KB align
-    flush_tlb();
+        user_video_tables[terminal_id][0].page_base_address = VIDMEM_PAGE_BASE + terminal_id + 1; // Set page to background 
 }
 
 /*
@@ -214,47 +711,9 @@ void change_terminal_video_page(int32_t from_terminal_id, int32_t to_terminal_id
 
     // Restore new terminal's screen from background buffer to video memory
     memcpy((void *)VIDMEM, (void *)(VIDMEM + (to_terminal_id + 1) * FOUR_KB), FOUR_KB);
-    flush_tlb();
-}
 
-/*
- * redirect_vidmem_page
- *    DESCRIPTION: Helper function to remap where virtual addr 0xB8000 for vidmem maps to physically
- *    INPUTS: terminal_id -- The terminal id that wants to write to its video page 
- *    OUTPUTS: none
- *    RETURNS: none 
- *    NOTES: This would only be used for a terminal that is currently scheduled to run but isn't
- *           the currently visible terminal. After this is called, all writes to vidmem will be redirected
- *           to the background buffer page corresponding to terminal_id.
- */ 
-void redirect_vidmem_page(int32_t terminal_id) {
-
-    // Bounds check
-    if(terminal_id < 0 || terminal_id > 2)
-        return;
-
-    // Redirect kernel vidmem page (if it's the currently visible terminal, reset it back to VGA)
-    if(terminal_id == visible_terminal)
-        page_table_one[VIDMEM_PAGE_BASE].page_base_address = VIDMEM_PAGE_BASE;
-    
-    else    //redirects to background buffer so it wont display on screen
-        page_table_one[VIDMEM_PAGE_BASE].page_base_address = VIDMEM_PAGE_BASE + terminal_id + 1;
-
-    flush_tlb();
-}
-
-/*  
- * flush_tlb
- *    DESCRIPTION: Used to flush TLB after making a change to the paging structure
- *    INPUTS/OUTPUTS: NONE
- *    SIDE EFFECTS: Flushes TLB for paging
- *    NOTES: See (https://wiki.osdev.org/TLB)
- */ 
-void flush_tlb() {
-    asm volatile ("movl	%%cr3, %%eax;"
-	              "movl	%%eax, %%cr3;"
-                :               // no inputs
-                :               // no outputs
-                : "eax"        // clobbers eax
-    );
+    // Swap which terminal's vidmap page shows on screen (visible_terminal isn't updated yet)
+    user_video_tables[from_terminal_id][0].page_base_address = VIDMEM_PAGE_BASE + from_terminal_id + 1;
+    user_video_tables[to_terminal_id][0].page_base_address = VIDMEM_PAGE_BASE;
+    tlb_flush_page(TWO_FIVE_SIX_MB);    // other address spaces pick it up on their next CR3 load
 }
@@ -15,21 +15,96 @@
    Each page directory entry corresponds to 4MB of VirtMem, so 256 / 4 = 64 */
 #define USER_VID_PAGE_DIR_I 64
 
+/* Page directory index of 132MB, right after the program page. Files mapped with mmap go in this
+   4MB, through a 4KB page table per process */
+#define USER_MMAP_DIR_I 33
+#define USER_MMAP_ADDR (USER_MMAP_DIR_I * FOUR_MB)
+
+// More pages than this in one munmap reloads CR3 instead of flushing them one at a time
+#define MMAP_FLUSH_ALL_PAGES 16
+
 // Page base address for video memory (0xB8000 >> 12)
 #define VIDMEM_PAGE_BASE 0xB8
 
+/* Compile-time switch for program loading. When defined, execute() only maps the user program
+   page and the page fault handler fills each 4KB chunk of the image on first touch.
+   Comment it out to map the whole image in execute() instead. */
+#define LAZY_PROG_LOAD
+
 // (MP3.1) Page directory
 page_dir_desc_t page_directory[1024] __attribute__((aligned (FOUR_KB)));
 // (MP3.1) Page table
 page_tab_desc_t page_table_one[1024] __attribute__((aligned (FOUR_KB)));
-// (MP3.4) Page table for user video memory
-page_tab_desc_t user_video_table[1024] __attribute__((aligned (FOUR_KB)));
 
 // Function to initialize paging
 extern void init_paging(void);
 
-// Helper function to set up user page
-extern void set_user_prog_page(uint32_t pid, int32_t present_flag);
+// Helper function to identity map a 4MB kernel-only page
+extern void map_kernel_page(uint32_t dir_i);
+
+// Builds a process's page directory (shared kernel mappings plus its own user pages)
+extern int32_t init_process_dir(uint32_t pid, int32_t terminal_id);
+
+// Gives a reaped process's page directory and page tables back to the frame pool
+extern void free_process_tables(uint32_t pid);
+
+// Loads a process's page directory into CR3
+extern void switch_page_directory(uint32_t pid);
+
+// Page table entry "available" bit that marks a read-only page as copy-on-write
+#define PTE_AVAIL_COW 0x1
+// Page table entry "available" bit that marks an mmap page whose mapping goes on into the next page
+#define PTE_AVAIL_MMAP_CONT 0x2
+
+// Empties a process's program page table so every 4KB page is mapped on first touch
+extern int32_t init_user_prog_table(uint32_t pid);
+
+// Unmaps a process's program page and releases the frames behind it
+extern void release_user_prog_table(uint32_t pid);
+
+// Maps every page of the current executable at once (used when LAZY_PROG_LOAD is off)
+struct pcb;
+extern int32_t populate_user_prog_image(uint32_t pid, struct pcb* pcb);
+
+// Maps the 4KB page of the current program image containing fault_addr
+extern int32_t demand_load_page(uint32_t fault_addr);
+
+// Gives the current process a private, writable copy of the shared page containing fault_addr
+extern int32_t cow_fault(uint32_t fault_addr);
+
+// Number of pages mapped on demand and the cycles spent mapping them (for benchmarking)
+uint32_t demand_page_faults;
+uint32_t demand_page_cycles;
+
+// Shares the running process's user pages copy-on-write with a forked child
+extern int32_t fork_user_pages(uint32_t parent_pid, uint32_t child_pid, int32_t terminal_id);
+
+// Copy-on-write counters
+typedef struct cow_stats {
+    uint32_t shared_maps;       // pages mapped read-only onto a shared frame
+    uint32_t copies;            // writes that needed a private copy of a shared frame
+    uint32_t reuses;            // writes that found the frame was no longer shared
+} cow_stats_t;
+
+cow_stats_t cow_stats;
+
+// Maps a file read-only into a process's mmap area, returns its user address or 0 if it doesn't fit
+extern uint32_t mmap_file(uint32_t pid, uint32_t inode);
+
+// Unmaps the mapping that starts at addr in a process's mmap area
+extern int32_t munmap_pages(uint32_t pid, uint32_t addr);
+
+// Unmaps everything in a process's mmap area
+extern void release_user_mmap_table(uint32_t pid);
+
+// mmap counters
+typedef struct mmap_stats {
+    uint32_t maps;              // files mapped
+    uint32_t direct_pages;      // pages mapped straight onto a filesystem data block
+    uint32_t copied_pages;      // pages whose block wasn't page-aligned, copied into a frame
+} mmap_stats_t;
+
+mmap_stats_t mmap_stats;
 
 // Helper function to set up user video memory page
 extern void set_user_video_page(int32_t present_flag);
@@ -37,10 +112,4 @@ extern void set_user_video_page(int32_t present_flag);
 // Helper function to save and copy video memory for visible terminal switching
 void change_terminal_video_page(int32_t from_terminal_id, int32_t to_terminal_id);
 
-// Helper function to remap where virtual video memory maps to physically
-void redirect_vidmem_page(int32_t terminal_id); 
-
-// Function to flush TLB
-extern void flush_tlb(void);
-
 #endif /* _PAGING_H */
@@ -0,0 +1,217 @@
+/* pipe.c - In-kernel pipes between processes
+ * vim:ts=4 noexpandtab
+ */
+
+/* A pipe is a page-sized ring with a reader count and a writer count. Readers sleep on the
+ * pipe's read queue while it's empty and writers on its write queue while it's full, each side
+ * waking the other when it moves data, so a blocked end takes no turns until there's something
+ * for it to do. An empty pipe with no writers left reads as the end of the stream, and a write
+ * with no readers left fails. The buffer is exactly one frame, so it comes straight from the
+ * frame allocator, and the pipe itself from a slab cache. Both are given back when the last
+ * descriptor on either end is closed.
+ */
+
+#include "pipe.h"
+#include "slab.h"
+#include "frames.h"
+#include "lib.h"
+
+static slab_cache_t pipe_cache;
+
+/*
+ * init_pipes
+ *    DESCRIPTION: Sets up the cache pipes come from
+ *    INPUTS/OUTPUTS: none
+ *    NOTES: Memory is only taken when the first pipe is created
+ */
+void init_pipes(void) {
+    slab_cache_init(&pipe_cache, "pipe", sizeof(pipe_t), SLAB_CACHE_LINE);
+    memset(&pipe_stats, 0, sizeof(pipe_stats));
+}
+
+/*
+ * pipe_alloc
+ *    DESCRIPTION: Creates an empty pipe
+ *    INPUTS: none
+ *    RETURNS: the pipe, with one reader and one writer counted, or NULL if there was no memory
+ */
+pipe_t* pipe_alloc(void) {
+    pipe_t *p = slab_alloc(&pipe_cache);
+    uint32_t buf;
+
+    if(p == NULL)
+        return NULL;
+    if((buf = frame_alloc()) == 0) {
+        slab_free(&pipe_cache, p);
+        return NULL;
+    }
+
+    p->buf = (uint8_t*)buf;
+    p->head = 0;
+    p->tail = 0;
+    p->readers = 1;
+    p->writers = 1;
+    init_wait_queue(&p->read_wait);
+    init_wait_queue(&p->write_wait);
+    pipe_stats.created++;
+    pipe_stats.live++;
+    return p;
+}
+
+/*
+ * pipe_dup
+ *    DESCRIPTION: Counts a copy of a file descriptor on the pipe end it refers to
+ *    INPUTS: file -- the copy (a forked child's, or the target of dup2)
+ *    RETURNS: none
+ *    NOTES: Does nothing for descriptors that aren't pipe ends
+ */
+void pipe_dup(file_descriptor_t* file) {
+    uint32_t flags;
+
+    if(file->flags == 0 || file->pipe == NULL)
+        return;
+
+    cli_and_save(flags);
+    if(file->fops_table_ptr.read == pipe_read)
+        file->pipe->readers++;
+    else
+        file->pipe->writers++;
+    restore_flags(flags);
+}
+
+/*
+ * pipe_read
+ *    DESCRIPTION: Reads whatever is in the pipe, up to nbytes, sleeping until there's something
+ *    INPUTS: fd -- file descriptor of the read end
+ *            buf -- output buffer
+ *            nbytes -- most bytes to read
+ *    RETURNS: Bytes read, 0 once the pipe is empty and every write end is closed, -1 if nbytes < 0
+ *    SIDE EFFECTS: Wakes writers waiting for room
+ */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes) {
+    pipe_t *p = current_pcb->fda[fd].pipe;
+    uint32_t flags, n, start, first;
+
+    if(nbytes < 0)
+        return -1;
+    if(nbytes == 0)
+        return 0;
+
+    cli_and_save(flags);
+    while(p->tail == p->head) {
+        if(p->writers == 0) {
+            restore_flags(flags);
+            return 0;
+        }
+        pipe_stats.read_blocks++;
+        sleep_on(&p->read_wait);
+    }
+
+    n = p->tail - p->head;
+    if(n > (uint32_t)nbytes)
+        n = nbytes;
+    start = p->head & PIPE_BUF_MASK;
+    first = PIPE_BUF_SIZE - start;      // bytes before the ring wraps
+    if(first > n)
+        first = n;
+    memcpy(buf, p->buf + start, first);
+    memcpy((uint8_t*)buf + first, p->buf, n - first);
+    p->head += n;
+    pipe_stats.bytes += n;
+
+    wake_up(&p->write_wait);
+    restore_flags(flags);
+    return n;
+}
+
+/*
+ * pipe_write
+ *    DESCRIPTION: Writes all of buf into the pipe, sleeping whenever it's full
+ *    INPUTS: fd -- file descriptor of the write end
+ *            buf -- input buffer
+ *            nbytes -- bytes to write
+ *    RETURNS: nbytes, fewer if every read end was closed partway, -1 if none was open to begin
+ *             with or nbytes < 0
+ *    SIDE EFFECTS: Wakes readers waiting for data after every chunk, so a write bigger than the
+ *                  pipe streams through it
+ */
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes) {
+    pipe_t *p = current_pcb->fda[fd].pipe;
+    uint32_t flags, n, start, first, written = 0;
+
+    if(nbytes < 0)
+        return -1;
+
+    cli_and_save(flags);
+    while(written < (uint32_t)nbytes) {
+        // Nobody is left to read the rest
+        if(p->readers == 0)
+            break;
+        if(p->tail - p->head == PIPE_BUF_SIZE) {
+            pipe_stats.write_blocks++;
+            sleep_on(&p->write_wait);
+            continue;
+        }
+
+        n = PIPE_BUF_SIZE - (p->tail - p->head);
+        if(n > nbytes - written)
+            n = nbytes - written;
+        start = p->tail & PIPE_BUF_MASK;
+        first = PIPE_BUF_SIZE - start;  // bytes before the ring wraps
+        if(first > n)
+            first = n;
+        memcpy(p->buf + start, (const uint8_t*)buf + written, first);
+        memcpy(p->buf, (const uint8_t*)buf + written + first, n - first);
+        p->tail += n;
+        written += n;
+
+        wake_up(&p->read_wait);
+    }
+    restore_flags(flags);
+
+    if(written == 0 && nbytes != 0)
+        return -1;
+    return written;
+}
+
+/*
+ * pipe_open
+ *    DESCRIPTION: Does nothing, pipes are made by the pipe syscall and have no name to open
+ *    RETURNS: Always -1
+ */
+int32_t pipe_open(const uint8_t* filename) {
+    return -1;
+}
+
+/*
+ * pipe_close
+ *    DESCRIPTION: Closes one descriptor on a pipe end
+ *    INPUTS: fd -- file descriptor of either end
+ *    RETURNS: Always 0
+ *    SIDE EFFECTS: Wakes the other end, which may be waiting on this one to go away. The pipe is
+ *                  freed once no descriptor is open on either end
+ */
+int32_t pipe_close(int32_t fd) {
+    file_descriptor_t *file = &current_pcb->fda[fd];
+    pipe_t *p = file->pipe;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if(file->fops_table_ptr.read == pipe_read) {
+        p->readers--;
+        wake_up(&p->write_wait);
+    }
+    else {
+        p->writers--;
+        wake_up(&p->read_wait);
+    }
+    file->pipe = NULL;
+
+    if(p->readers == 0 && p->writers == 0) {
+        frame_put((uint32_t)p->buf);
+        slab_free(&pipe_cache, p);
+        pipe_stats.live--;
+    }
+    restore_flags(flags);
+    return 0;
+}
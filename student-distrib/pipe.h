@@ -0,0 +1,54 @@
+/* pipe.h - In-kernel pipes between processes
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PIPE_H
+#define _PIPE_H
+
+#include "types.h"
+#include "x86_desc.h"
+#include "scheduler.h"
+#include "system_calls.h"
+
+// Bytes a pipe holds before its writer has to wait, one frame
+#define PIPE_BUF_SIZE FOUR_KB
+#define PIPE_BUF_MASK (PIPE_BUF_SIZE - 1)
+
+// A one-way byte stream, shared by every file descriptor open on either end
+typedef struct pipe {
+    uint8_t* buf;               // PIPE_BUF_SIZE byte ring, a frame of its own
+    uint32_t head;              // bytes ever read (the ring position is head & PIPE_BUF_MASK)
+    uint32_t tail;              // bytes ever written
+    uint32_t readers;           // file descriptors open on the read end
+    uint32_t writers;           // file descriptors open on the write end
+    wait_queue_t read_wait;     // readers waiting for data (or for the last writer to close)
+    wait_queue_t write_wait;    // writers waiting for room (or for the last reader to close)
+} pipe_t;
+
+// Pipe counters
+typedef struct pipe_stats {
+    uint32_t created;           // pipes made by the pipe syscall
+    uint32_t live;              // pipes with an end still open
+    uint32_t bytes;             // bytes that went through a pipe
+    uint32_t read_blocks;       // times a reader found its pipe empty and slept
+    uint32_t write_blocks;      // times a writer found its pipe full and slept
+} pipe_stats_t;
+
+pipe_stats_t pipe_stats;
+
+// Sets up the cache pipes come from
+extern void init_pipes(void);
+
+// Creates an empty pipe with one reader and one writer, NULL if there's no memory for it
+extern pipe_t* pipe_alloc(void);
+
+// Counts a copied file descriptor (fork, dup2) on the pipe end it refers to, no-op for other files
+extern void pipe_dup(file_descriptor_t* file);
+
+// fops for the two ends of a pipe
+extern int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes);
+extern int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes);
+extern int32_t pipe_open(const uint8_t* filename);
+extern int32_t pipe_close(int32_t fd);
+
+#endif /* _PIPE_H */
@@ -5,6 +5,9 @@
 #include "scheduler.h"
 
 
+// 10ms ticks the one-shot in flight was armed for, charged to the running process when it fires
+static uint32_t pit_armed_ticks = 0;
+
 /*
  * init_PIT
  *    DESCRIPTION: Initialize PIT to 100Hz/10ms and turns on IRQ0 
@@ -12,18 +15,87 @@
  *    OUTPUTS: none
  *    RETURNS: none
  *    SIDE EFFECTS: Turns on periodic interrupts for scheduler
- *    NOTES: 
+ *    NOTES: In TICKLESS mode there's just one interrupt to start the first process,
+ *           the scheduler arms the rest
  */
 void init_PIT(){
     //cli();
+#ifndef TICKLESS
     outb(PIT_MODE_2, PIT_MODE_REG);  // Select PIT channel 0, lobyte/hibyte access, rate gen. mode
     outb(PIT_FREQ & 0xFF, PIT_CH0);       // Set low byte of PIT reload value
     outb((PIT_FREQ & 0xFF00)>>8, PIT_CH0);        // Set high byte of PIT reload value
+#endif
+    calibrate_tsc();    // Channel 2 doesn't raise interrupts, so this can run before IRQ0 is on
     SET_IDT_ENTRY(idt[0x20], &PIT_processor);   // Set entry on IDT
     enable_irq(PIT_IRQ);    // Enable IRQ on PIC
+#ifdef TICKLESS
+    pit_arm(1);
+#endif
     //sti();
 }
 
+/*
+ * calibrate_tsc
+ *    DESCRIPTION: Counts TSC ticks across a PIT_CAL_MS one-shot on PIT channel 2
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURNS: none
+ *    SIDE EFFECTS: Sets tsc_khz, busy-waits for PIT_CAL_MS
+ *    NOTES: See (https://wiki.osdev.org/Programmable_interval_timer), the speaker stays off
+ */
+void calibrate_tsc(){
+    uint64_t start;
+    uint32_t cycles;
+
+    outb((inb(PIT_CH2_GATE_PORT) & ~0x02) | 0x01, PIT_CH2_GATE_PORT);   // Gate channel 2 on, speaker off
+    outb(PIT_CH2_ONE_SHOT, PIT_MODE_REG);
+    outb(PIT_CAL_COUNT & 0xFF, PIT_CH2);
+    outb((PIT_CAL_COUNT & 0xFF00) >> 8, PIT_CH2);   // Loading the high byte starts the one-shot
+    start = rdtsc();
+
+    while(!(inb(PIT_CH2_GATE_PORT) & 0x20));        // Output goes high when the count runs out
+    cycles = (uint32_t)(rdtsc() - start);
+
+    outb(inb(PIT_CH2_GATE_PORT) & ~0x01, PIT_CH2_GATE_PORT);    // Gate channel 2 back off
+    tsc_khz = cycles / PIT_CAL_MS;
+}
+
+/*
+ * pit_arm
+ *    DESCRIPTION: Programs channel 0 to interrupt once after some 10ms ticks
+ *    INPUTS: ticks -- ticks until the interrupt, at most PIT_MAX_ARM_TICKS count
+ *    OUTPUTS: none
+ *    RETURNS: none
+ *    SIDE EFFECTS: Replaces whatever one-shot was in flight
+ */
+void pit_arm(uint32_t ticks){
+    uint32_t count;
+
+    if(ticks == 0)
+        ticks = 1;
+    if(ticks > PIT_MAX_ARM_TICKS)
+        ticks = PIT_MAX_ARM_TICKS;
+    count = ticks * PIT_FREQ;
+
+    pit_armed_ticks = ticks;
+    outb(PIT_ONE_SHOT, PIT_MODE_REG);
+    outb(count & 0xFF, PIT_CH0);
+    outb((count & 0xFF00) >> 8, PIT_CH0);   // Loading the high byte starts the count
+}
+
+/*
+ * pit_stop
+ *    DESCRIPTION: Stops channel 0
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURNS: none
+ *    SIDE EFFECTS: Writing the mode without a count leaves the counter waiting, so nothing fires
+ */
+void pit_stop(){
+    pit_armed_ticks = 0;
+    outb(PIT_ONE_SHOT, PIT_MODE_REG);
+}
+
 /*
  * PIT_interrupt
  *    DESCRIPTION: Calls scheduler on every PIT interrupt
@@ -34,6 +106,19 @@ void init_PIT(){
  *    NOTES: 
  */ 
 void PIT_handler(){
+    uint32_t ticks;
+
     send_eoi(PIT_IRQ);  //supplemental session included this before calling scheduler helper
-    scheduler();        //PIT handler calls scheduling algorithm
+    pit_interrupts++;
+    if(sched_in_idle)   //the scheduler is already waiting for something to run
+        return;
+#ifdef TICKLESS
+    ticks = pit_armed_ticks;    // a one-shot covers as many ticks as it was armed for
+    pit_armed_ticks = 0;
+    if(ticks == 0)              // stopped since it fired
+        return;
+#else
+    ticks = 1;
+#endif
+    sched_tick(ticks);  //PIT handler calls scheduling algorithm
 }
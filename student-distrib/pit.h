@@ -16,6 +16,25 @@
 //Note: must be as responsive as possible, so we chose min frequency required
 #define PIT_FREQ            11932       // 1193180/100Hz(10ms) for frequency
 #define PIT_MODE_2          0x34
+#define PIT_ONE_SHOT        0x30        // channel 0, lobyte/hibyte access, interrupt on terminal count
+#define PIT_MAX_ARM_TICKS   5           // most 10ms ticks one 16-bit count can hold
+
+// Only interrupt when the running process's slice is up, and not at all while idle
+// (comment out for a fixed 100Hz tick)
+#define TICKLESS
+
+// Channel 2 is used once at boot to measure the TSC frequency
+#define PIT_CH2             0x42
+#define PIT_CH2_GATE_PORT   0x61        // bit 0 gates channel 2, bit 1 drives the speaker, bit 5 reads its output
+#define PIT_CH2_ONE_SHOT    0xB0        // channel 2, lobyte/hibyte access, interrupt on terminal count
+#define PIT_CAL_MS          10          // length of the calibration interval
+#define PIT_CAL_COUNT       (PIT_FREQ * PIT_CAL_MS / 10)  // PIT_FREQ counts are 10ms
+
+// TSC ticks per millisecond, measured against the PIT at boot
+uint32_t tsc_khz;
+
+// Interrupts taken on IRQ0, to compare tickless against the fixed tick
+uint32_t pit_interrupts;
 
 // Initialize the RTC and turn on IRQ8
 void init_PIT();
@@ -23,4 +42,13 @@ void init_PIT();
 // Handles interrupts from the real-time clock
 extern void PIT_handler();
 
+// Measures tsc_khz using PIT channel 2
+extern void calibrate_tsc();
+
+// Fires IRQ0 once, ticks 10ms ticks from now (clamped to PIT_MAX_ARM_TICKS)
+extern void pit_arm(uint32_t ticks);
+
+// Stops channel 0 so no IRQ0 comes until the next pit_arm
+extern void pit_stop();
+
 #endif /* _PIT_H */
@@ -0,0 +1,194 @@
+/* process.c - PID allocation and on-demand PCBs and kernel stacks
+ * vim:ts=4 noexpandtab
+ */
+
+/* PIDs below MAX_TERMINALS belong to the base shells, which keep theirs for good. Every other PID
+ * waits on a FIFO while it's free, so allocating and releasing one is O(1) and a PID isn't handed
+ * out again until the rest of the free ones have been. A process's PCB and kernel stack come from
+ * their own slab caches, so the number of processes is bounded by MAX_PIDS and memory, not by a
+ * fixed layout below 8MB.
+ */
+
+#include "process.h"
+#include "slab.h"
+#include "paging.h"
+#include "terminal.h"
+#include "lib.h"
+
+#define PID_MASK (MAX_PIDS - 1)
+
+// PCB of every PID in use, NULL for free PIDs
+static pcb_t* pid_table[MAX_PIDS];
+
+// Ring of free PIDs (MAX_PIDS is a power of two)
+static uint16_t free_pids[MAX_PIDS];
+static uint32_t free_pid_head;
+static uint32_t free_pid_count;
+
+static slab_cache_t pcb_cache;
+static slab_cache_t kstack_cache;
+
+// Forked processes that halted with no parent left to wait for them, linked through zombie_next
+static pcb_t* orphans;
+
+/*
+ * init_processes
+ *    DESCRIPTION: Puts every PID above the base shells' on the free list and sets up the caches
+ *                 PCBs and kernel stacks come from
+ *    INPUTS/OUTPUTS: none
+ *    NOTES: Memory is only taken when the first process is created, after init_frames()
+ */
+void init_processes(void) {
+    uint32_t pid;
+
+    free_pid_head = 0;
+    free_pid_count = 0;
+    for(pid = MAX_TERMINALS; pid < MAX_PIDS; pid++)
+        free_pids[free_pid_count++] = pid;
+
+    slab_cache_init(&pcb_cache, "pcb", sizeof(pcb_t), SLAB_CACHE_LINE);
+    slab_cache_init(&kstack_cache, "kstack", KERNEL_STACK_SIZE, FOUR_KB);
+    memset(&process_stats, 0, sizeof(process_stats));
+    orphans = NULL;
+}
+
+/*
+ * process_alloc
+ *    DESCRIPTION: Creates the kernel side of a new process
+ *    INPUTS: pid -- PID of a base shell (below MAX_TERMINALS), or -1 for the next free PID
+ *    RETURNS: the zeroed PCB with process_id and kernel_stack filled in, or NULL if there is no
+ *             free PID (or the base shell's is taken) or no memory for the PCB or stack
+ */
+pcb_t* process_alloc(int32_t pid) {
+    uint32_t flags;
+    pcb_t *pcb;
+    void *stack;
+
+    cli_and_save(flags);
+
+    // Orphans that halted since the last call are off their stacks by now
+    while(orphans != NULL) {
+        pcb = orphans;
+        orphans = pcb->zombie_next;
+        process_free(pcb);
+    }
+
+    if(pid < 0) {
+        if(free_pid_count == 0) {
+            process_stats.failures++;
+            restore_flags(flags);
+            return NULL;
+        }
+        pid = free_pids[free_pid_head];
+        free_pid_head = (free_pid_head + 1) & PID_MASK;
+        free_pid_count--;
+    }
+    else if(pid >= MAX_TERMINALS || pid_table[pid] != NULL) {
+        process_stats.failures++;
+        restore_flags(flags);
+        return NULL;
+    }
+
+    pcb = slab_alloc(&pcb_cache);
+    stack = slab_alloc(&kstack_cache);
+    if(pcb == NULL || stack == NULL) {
+        slab_free(&pcb_cache, pcb);
+        slab_free(&kstack_cache, stack);
+        if(pid >= MAX_TERMINALS)
+            free_pids[(free_pid_head + free_pid_count++) & PID_MASK] = pid;
+        process_stats.failures++;
+        restore_flags(flags);
+        return NULL;
+    }
+
+    memset(pcb, 0, sizeof(pcb_t));
+    pcb->process_id = pid;
+    pcb->kernel_stack = (uint32_t)stack;
+    pid_table[pid] = pcb;
+
+    process_stats.created++;
+    if(++process_stats.live > process_stats.peak)
+        process_stats.peak = process_stats.live;
+    restore_flags(flags);
+    return pcb;
+}
+
+/*
+ * process_free
+ *    DESCRIPTION: Reaps a process, giving back everything process_alloc() and execute() gave it
+ *    INPUTS: pcb -- process to free, must not be running on its page directory anymore
+ *    RETURNS: none
+ *    SIDE EFFECTS: The PCB and kernel stack go back to their caches, so the caller has to copy
+ *                  out anything it still needs from them first
+ *    NOTES: halt() calls this on the stack it frees, with interrupts off until it leaves it
+ */
+void process_free(pcb_t* pcb) {
+    uint32_t flags, pid = pcb->process_id;
+
+    cli_and_save(flags);
+    free_process_tables(pid);
+    pid_table[pid] = NULL;
+    if(pid >= MAX_TERMINALS)
+        free_pids[(free_pid_head + free_pid_count++) & PID_MASK] = pid;
+
+    slab_free(&kstack_cache, (void*)pcb->kernel_stack);
+    slab_free(&pcb_cache, pcb);
+    process_stats.live--;
+    restore_flags(flags);
+}
+
+/*
+ * pid_to_pcb
+ *    DESCRIPTION: Looks up a process by PID
+ *    INPUTS: pid -- PID to look up
+ *    RETURNS: the process's PCB, NULL if the PID is free or out of range
+ */
+pcb_t* pid_to_pcb(uint32_t pid) {
+    if(pid >= MAX_PIDS)
+        return NULL;
+    return pid_table[pid];
+}
+
+/*
+ * process_disown_children
+ *    DESCRIPTION: Cuts a halting process's forked children loose
+ *    INPUTS: pcb -- process that is halting
+ *    RETURNS: none
+ *    SIDE EFFECTS: Children that already halted are freed, the rest lose their parent and get
+ *                  freed by process_free_later when they halt
+ *    NOTES: Call with interrupts off
+ */
+void process_disown_children(pcb_t* pcb) {
+    pcb_t *child;
+    uint32_t pid;
+
+    while((child = pcb->zombies) != NULL) {
+        pcb->zombies = child->zombie_next;
+        pcb->forked_children--;
+        process_free(child);
+    }
+
+    for(pid = 0; pid < MAX_PIDS && pcb->forked_children > 0; pid++) {
+        child = pid_table[pid];
+        if(child != NULL && child->forked && child->parent_pcb == pcb) {
+            child->parent_pcb = NULL;
+            pcb->forked_children--;
+        }
+    }
+}
+
+/*
+ * process_free_later
+ *    DESCRIPTION: Queues a halted process that nobody will wait for to be freed
+ *    INPUTS: pcb -- the running process, which is about to switch away for good
+ *    RETURNS: none
+ *    NOTES: It can't free its own stack while still on it, so the next process_alloc() does
+ */
+void process_free_later(pcb_t* pcb) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    pcb->zombie_next = orphans;
+    orphans = pcb;
+    restore_flags(flags);
+}
@@ -0,0 +1,46 @@
+/* process.h - PID allocation and on-demand PCBs and kernel stacks
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PROCESS_H
+#define _PROCESS_H
+
+#include "types.h"
+#include "x86_desc.h"
+#include "system_calls.h"
+
+// Every process gets its own kernel stack of this size from the kernel stack cache
+#define KERNEL_STACK_SIZE EIGHT_KB
+
+// Where tss.esp0 points while pcb is running (top of its kernel stack)
+#define PCB_ESP0(pcb) ((pcb)->kernel_stack + KERNEL_STACK_SIZE - 4)
+
+// Process counters
+typedef struct process_stats {
+    uint32_t live;              // processes that have a PID right now, base shells included
+    uint32_t peak;              // most processes alive at once
+    uint32_t created;           // successful process_alloc() calls
+    uint32_t failures;          // process_alloc() calls that ran out of PIDs or memory
+} process_stats_t;
+
+process_stats_t process_stats;
+
+// Sets up the PID free list and the PCB and kernel stack caches
+extern void init_processes(void);
+
+// Gives a new process a PID, a PCB and a kernel stack (pid < 0 picks a free PID), NULL on failure
+extern pcb_t* process_alloc(int32_t pid);
+
+// Gives a process's PID, PCB, kernel stack and page tables back
+extern void process_free(pcb_t* pcb);
+
+// Frees a halting process's halted forked children and detaches the ones still running
+extern void process_disown_children(pcb_t* pcb);
+
+// Frees a halted forked process with no parent once it has switched away
+extern void process_free_later(pcb_t* pcb);
+
+// Returns the PCB of the process with pid, NULL if no process has it
+extern pcb_t* pid_to_pcb(uint32_t pid);
+
+#endif /* _PROCESS_H */
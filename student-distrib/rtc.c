@@ -20,7 +20,8 @@
  *    OUTPUTS: none
  *    RETURNS: none
  *    SIDE EFFECTS: Turns on periodic interupts
- *    NOTES: See OSDev links in .h file to understand macros
+ *    NOTES: See OSDev links in .h file to understand macros. IRQ8 stays masked until
+ *           a terminal opens the RTC (see rtc_update_irq)
  */ 
 void init_RTC() {
 
@@ -40,7 +41,6 @@ void init_RTC() {
     // Set RTC to maximum freq. of 1024 Hz
     outb(prev | HIGHEST_FREQ_BITMASK, CMOS_PORT);
 
-    enable_irq(RTC_IRQ);
     SET_IDT_ENTRY(idt[0x28], &RTC_processor);             //index 28 of IDT reserved for RTC
     //sti();                      // (perform an STI) and reenable NMI if you wish? 
 
@@ -66,16 +66,43 @@ void RTC_interrupt(){
             terminals[i].rtc_countdown--;
             if(terminals[i].rtc_countdown == 0) {
                 terminals[i].rtc_virt_interrupt = 1;
+                wake_up(&terminals[i].rtc_wait);
                 terminals[i].rtc_countdown = HIGHEST_FREQ / terminals[i].rtc_freq;  // Reset countdown
             }
         }
     }
 
     send_eoi(RTC_IRQ);
+    sched_preempt();
     
     //test_interrupts();
 }
 
+/*
+ * rtc_update_irq
+ *    DESCRIPTION: Unmasks IRQ8 while any terminal has the RTC open and masks it otherwise
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURNS: none
+ *    SIDE EFFECTS: An idle kernel doesn't take 1024 interrupts a second that nobody wants
+ */
+static void rtc_update_irq() {
+    int i;
+    for(i = 0; i < MAX_TERMINALS; i++) {
+        if(terminals[i].rtc_active)
+            break;
+    }
+
+    if(i < MAX_TERMINALS) {
+        // An interrupt left unacknowledged while masked would hold the line and block every later one
+        outb(REGISTER_C, RTC_PORT);
+        inb(CMOS_PORT);
+        enable_irq(RTC_IRQ);
+    }
+    else
+        disable_irq(RTC_IRQ);
+}
+
 /*
  * RTC_open
  *    DESCRIPTION: Set virtual RTC frequency to 2 Hz and set countdown var
@@ -93,23 +120,29 @@ int32_t RTC_open(const uint8_t * filename) {
     // desired frequency, we must divide 1024 by this desired frequency to find the number of interrupts
     // at 1024Hz to see how many interrupts at 1024 is equivalent to one interrupt at desired frequency.  
     terminals[scheduled_terminal].rtc_countdown =  HIGHEST_FREQ / terminals[scheduled_terminal].rtc_freq;
+    rtc_update_irq();
     return 0;
 }
 
 /*
  * RTC_read
- *    DESCRIPTION: Blocks system until RTC interrupt
+ *    DESCRIPTION: Sleeps until the terminal's next virtual RTC interrupt
  *    INPUTS: none
  *    OUTPUTS: none
  *    RETURNS: Always returns 0
- *    SIDE EFFECTS: Blocks system until RTC interrupt
+ *    SIDE EFFECTS: Other processes run while this one waits
  *    NOTES: none
  */
 int32_t RTC_read(int32_t fd, void * buf, int32_t n_bytes) {
-    // Block until the interrupt handler determines that the scheduled terminal has hit its virtual RTC interrupt
-    while(!terminals[scheduled_terminal].rtc_virt_interrupt);
+    uint32_t flags;
+
+    // Sleep until the interrupt handler determines that the scheduled terminal has hit its virtual RTC interrupt
+    cli_and_save(flags);
+    while(!terminals[scheduled_terminal].rtc_virt_interrupt)
+        sleep_on(&terminals[scheduled_terminal].rtc_wait);
     // Reset virtual interrupt flag
     terminals[scheduled_terminal].rtc_virt_interrupt = 0;
+    restore_flags(flags);
     return 0;
 }
 
@@ -186,5 +219,6 @@ int32_t RTC_close(int32_t fd) {
     terminals[scheduled_terminal].rtc_active = 0;
     terminals[scheduled_terminal].rtc_countdown = 0;
     terminals[scheduled_terminal].rtc_virt_interrupt = 0;
+    rtc_update_irq();
     return 0;
 }
@@ -6,70 +6,481 @@
 #include "paging.h"
 #include "x86_desc.h"
 #include "rtc.h"
+#include "lib.h"
+#include "asm_linkage.h"
+#include "acct.h"
+#include "process.h"
 
 
 int shell_count = 0;
 
+// TSC at the start of the switch in progress (a global, since the stack changes mid-switch)
+static uint64_t switch_start;
+
+// One FIFO of ready PCBs per priority level (0 runs first), linked through run_next
+static pcb_t * run_queue_head[SCHED_LEVELS];
+static pcb_t * run_queue_tail[SCHED_LEVELS];
+
+// PIT ticks since boot, drives the periodic boost back to the top level
+static uint32_t sched_ticks = 0;
+static uint32_t last_boost_tick = 0;
+
+#ifdef TICKLESS
+// TSC the running process's slice has been charged up to, the one-shot only sees whole slices
+static uint64_t slice_start;
+#endif
+
+// Set when something woke up with a better level than the running process
+static volatile uint32_t sched_need_resched = 0;
+
+// Where the boot context's stack pointer goes when the first process is switched in (never resumed)
+static uint32_t boot_esp;
+
+/*
+ * run_queue_push
+ *    DESCRIPTION: Puts a process at the back of the run queue for its level
+ *    INPUTS: pcb -- process that's ready to run
+ *    OUTPUTS: none
+ *    NOTES: Call with interrupts off
+ */
+static void run_queue_push(pcb_t * pcb) {
+    uint32_t level = pcb->sched_level;
+
+    pcb->state = PROC_READY;
+    pcb->run_next = NULL;
+    if(run_queue_tail[level] == NULL)
+        run_queue_head[level] = pcb;
+    else
+        run_queue_tail[level]->run_next = pcb;
+    run_queue_tail[level] = pcb;
+}
+
+/*
+ * run_queue_pop
+ *    DESCRIPTION: Takes the process at the front of the best non-empty level
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURNS: The next process to run, or NULL if nothing is ready
+ *    NOTES: Call with interrupts off
+ */
+static pcb_t * run_queue_pop() {
+    uint32_t level;
+    pcb_t * pcb;
+
+    for(level = 0; level < SCHED_LEVELS; level++) {
+        pcb = run_queue_head[level];
+        if(pcb != NULL) {
+            run_queue_head[level] = pcb->run_next;
+            if(run_queue_head[level] == NULL)
+                run_queue_tail[level] = NULL;
+            return pcb;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * sched_boost_all
+ *    DESCRIPTION: Moves every queued process back up to the best level its nice value allows
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    SIDE EFFECTS: Keeps CPU-bound processes stuck at the bottom from starving forever
+ *    NOTES: Call with interrupts off. sched_tick does this every SCHED_BOOST_TICKS
+ */
+void sched_boost_all() {
+    uint32_t level;
+    pcb_t * pcb;
+    pcb_t * next;
+
+    // Take each level's list off before requeueing it, a process whose nice is that level
+    // goes right back onto it
+    for(level = 1; level < SCHED_LEVELS; level++) {
+        pcb = run_queue_head[level];
+        run_queue_head[level] = NULL;
+        run_queue_tail[level] = NULL;
+        for(; pcb != NULL; pcb = next) {
+            next = pcb->run_next;
+            pcb->sched_level = pcb->nice;
+            pcb->slice_left = SCHED_SLICE(pcb->sched_level);
+            run_queue_push(pcb);
+        }
+    }
+    if(current_pcb != NULL) {
+        current_pcb->sched_level = current_pcb->nice;
+        current_pcb->slice_left = SCHED_SLICE(current_pcb->sched_level);
+    }
+}
+
+/*
+ * sched_dequeue
+ *    DESCRIPTION: Takes a ready process back off the run queue
+ *    INPUTS: pcb -- process to take off
+ *    OUTPUTS: none
+ *    RETURNS: 0 if it was queued, -1 if it wasn't
+ *    NOTES: Call with interrupts off, the process's state is left for the caller to set
+ */
+int32_t sched_dequeue(pcb_t * pcb) {
+    uint32_t level = pcb->sched_level;
+    pcb_t * prev = NULL;
+    pcb_t * curr;
+
+    if(level >= SCHED_LEVELS)
+        return -1;
+    for(curr = run_queue_head[level]; curr != NULL; prev = curr, curr = curr->run_next) {
+        if(curr != pcb)
+            continue;
+        if(prev == NULL)
+            run_queue_head[level] = curr->run_next;
+        else
+            prev->run_next = curr->run_next;
+        if(run_queue_tail[level] == curr)
+            run_queue_tail[level] = prev;
+        curr->run_next = NULL;
+        return 0;
+    }
+    return -1;
+}
+
+/*
+ * sched_charge
+ *    DESCRIPTION: Takes PIT ticks off a process's slice and moves the scheduler's clock
+ *    INPUTS: pcb -- process that ran for them
+ *            ticks -- 10ms ticks it ran
+ *    OUTPUTS: none
+ *    RETURNS: 1 if that used up its slice, 0 otherwise
+ *    SIDE EFFECTS: A process that uses up its slice drops a level (CPU-bound processes sink),
+ *                  and every SCHED_BOOST_TICKS everything goes back to the top
+ *    NOTES: Call with interrupts off
+ */
+static uint32_t sched_charge(pcb_t * pcb, uint32_t ticks) {
+    sched_ticks += ticks;
+    if(sched_ticks - last_boost_tick >= SCHED_BOOST_TICKS) {
+        last_boost_tick = sched_ticks;
+        sched_boost_all();
+    }
+
+    if(pcb->slice_left > ticks)
+        pcb->slice_left -= ticks;
+    else
+        pcb->slice_left = 0;
+    if(pcb->slice_left != 0)
+        return 0;
+    if(pcb->sched_level < SCHED_LEVELS - 1) {
+        pcb->sched_level++;
+        sched_stats.demotions++;
+    }
+    return 1;
+}
+
+#ifdef TICKLESS
+/*
+ * sched_charge_early
+ *    DESCRIPTION: Charges the running process for the time it ran since its slice was last
+ *                 charged, when it gives up the CPU before its one-shot fires
+ *    INPUTS: pcb -- process leaving the CPU
+ *    OUTPUTS: none
+ *    SIDE EFFECTS: Cycles short of a whole tick stay in slice_cycles until they add up, so a
+ *                  process that keeps sleeping or getting preempted just before its slice ends
+ *                  still drops a level like it would with the fixed tick
+ *    NOTES: Call with interrupts off
+ */
+static void sched_charge_early(pcb_t * pcb) {
+    uint32_t tick_cycles = tsc_khz * 10;    // A PIT tick is 10ms
+    uint32_t ticks;
+
+    pcb->slice_cycles += (uint32_t)(rdtsc() - slice_start);
+    if(tick_cycles == 0)
+        return;
+    ticks = pcb->slice_cycles / tick_cycles;
+    pcb->slice_cycles %= tick_cycles;
+    if(ticks != 0)
+        sched_charge(pcb, ticks);
+}
+#endif
+
+/*
+ * base_shell_entry
+ *    DESCRIPTION: First code a base shell's kernel stack runs, context_switch returns into it
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURNS: never
+ */
+static void base_shell_entry() {
+    int32_t terminal_id = current_pcb->terminal_id;
+
+    shell_count++;
+    switch_visible_terminal(terminal_id);    // Switch video page so the bootup text stays in that terminal
+    printf("Terminal %d booting...\n", shell_count);
+    execute_base_shell(terminal_id);
+}
+
+/*
+ * init_scheduler
+ *    DESCRIPTION: Queues up a base shell for every terminal
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    SIDE EFFECTS: The shells start running once the PIT calls the scheduler
+ *    NOTES: Needs paging and init_processes(), base shell i gets pid i
+ */
+void init_scheduler() {
+    int32_t i;
+    for(i = 0; i < MAX_TERMINALS; i++) {
+        pcb_t * pcb = process_alloc(i);
+        if(pcb == NULL)
+            continue;
+        uint32_t * stack = (uint32_t *)PCB_ESP0(pcb);
+
+        // Lay out the frame context_switch pops, returning into base_shell_entry
+        *(--stack) = (uint32_t)base_shell_entry;
+        *(--stack) = 0;     // ebp
+        *(--stack) = 0;     // ebx
+        *(--stack) = 0;     // esi
+        *(--stack) = 0;     // edi
+
+        pcb->process_id = i;
+        pcb->parent_process_id = i;
+        pcb->terminal_id = i;
+        pcb->saved_syscall = 0;
+        pcb->nice = 0;
+        pcb->sched_level = 0;
+        pcb->slice_left = SCHED_SLICE(0);
+        pcb->wake_tsc = 0;
+        pcb->curr_esp = (uint32_t)stack;
+        init_process_dir(i, i);
+        run_queue_push(pcb);
+    }
+}
+
+/*
+ * sched_add
+ *    DESCRIPTION: Puts a brand new process on the run queue
+ *    INPUTS: pcb -- process whose kernel stack is already laid out for context_switch
+ *    OUTPUTS: none
+ *    NOTES: For fork, the child takes its first turn whenever the scheduler gets to it
+ */
+void sched_add(pcb_t * pcb) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    run_queue_push(pcb);
+    restore_flags(flags);
+}
+
 /*
  * scheduler
  *    DESCRIPTION: Performs process switching
  *    INPUTS: none
  *    OUTPUTS: none
- *    SIDE EFFECTS: Switches active process using round-robin scheduling
+ *    SIDE EFFECTS: Sends a still running process to the back of its level's queue and switches
+ *                  to the front of the best level, halting until something is ready if it's empty
+ *    NOTES: Call with interrupts off. Blocked and zombie processes aren't queued, so they (and
+ *           terminals with nothing to do) take no turns
  */
 void scheduler(){   
-    // Get the current active process's PCB
-    pcb_t * curr_pcb = terminals[scheduled_terminal].terminal_pcb;
-        
-    // Boot up the three terminals
-    if(curr_pcb == NULL && shell_count < 3){
-        pcb_t temp_pcb;
-        asm volatile(       // Retrieve initial ESP and EBP before booting base shells
-            "movl %%esp, %0;"
-            "movl %%ebp, %1;"
-            : "=r"(temp_pcb.curr_esp), "=r"(temp_pcb.curr_ebp) // Outputs
-        );
-        shell_count++;
-        terminals[scheduled_terminal].terminal_pcb = &temp_pcb;
-        terminals[scheduled_terminal].last_assigned_pid = scheduled_terminal;   //mark terminal as booted and initialize its pid
-
-        switch_visible_terminal(scheduled_terminal);    // Switch video page so the bootup text stays in that terminal
-        printf("Terminal %d booting...\n", shell_count);
-        execute((uint8_t *)"shell");
-    }
+    pcb_t * curr_pcb = current_pcb;
+    pcb_t * next_pcb;
 
-    // Save old process's stack
-    // This properly sets up first base shell's ESP/EBP by forcing it into this context
-    asm volatile(       
-        "movl %%esp, %0;"
-        "movl %%ebp, %1;"
-        : "=r"(curr_pcb->curr_esp), "=r"(curr_pcb->curr_ebp) // Outputs
-    );
+    sched_need_resched = 0;
 
-    // Round-robin increment
-    scheduled_terminal = (scheduled_terminal + 1) % MAX_TERMINALS;
+#ifdef TICKLESS
+    // Leaving before the one-shot fired (asleep or preempted), so it hasn't been charged yet
+    if(curr_pcb != NULL)
+        sched_charge_early(curr_pcb);
+#endif
 
-    // If the next terminal hasn't been booted yet, boot it on the next PIT interrupt
-    if(terminals[scheduled_terminal].terminal_pcb == NULL)
+    // Preempted, not blocked, so it's still ready to run
+    if(curr_pcb != NULL && curr_pcb->state == PROC_RUNNING)
+        run_queue_push(curr_pcb);
+
+    // Nothing is ready, so sleep until an interrupt handler wakes a process up
+    while((next_pcb = run_queue_pop()) == NULL) {
+        uint64_t idle_start = rdtsc();
+#ifdef TICKLESS
+        pit_stop();     // No slice to end, so only keyboard/RTC interrupts can wake us
+#endif
+        acct_charge();
+        sched_in_idle = 1;
+        asm volatile ("sti; hlt; cli" ::: "memory");
+        sched_in_idle = 0;
+        sched_stats.idle_cycles += rdtsc() - idle_start;
+        acct_skip();    // Nobody ran while idle
+    }
+    next_pcb->state = PROC_RUNNING;
+    if(next_pcb->slice_left == 0)
+        next_pcb->slice_left = SCHED_SLICE(next_pcb->sched_level);
+#ifdef TICKLESS
+    pit_arm(next_pcb->slice_left);  // The next interrupt is when this slice runs out
+    slice_start = rdtsc();
+#endif
+
+    // How long a woken process waited for the CPU (what an interactive process feels as lag)
+    if(next_pcb->wake_tsc != 0) {
+        uint32_t wake_cycles = (uint32_t)(rdtsc() - next_pcb->wake_tsc);
+        next_pcb->wake_tsc = 0;
+        sched_stats.wake_runs++;
+        sched_stats.wake_cycles += wake_cycles;
+        if(wake_cycles > sched_stats.max_wake_cycles)
+            sched_stats.max_wake_cycles = wake_cycles;
+    }
+
+    // Nothing else wants to run, keep going without switching
+    if(next_pcb == curr_pcb)
         return;
-    
-    set_user_video_page(1);
 
-    pcb_t * next_pcb = terminals[scheduled_terminal].terminal_pcb;
+    switch_start = rdtsc();
+
+    // Charge the old process up to the switch
+    acct_charge();
+    if(curr_pcb != NULL)
+        curr_pcb->acct.switches++;
+
+    // Whatever syscall the old process was in stays with it, the switch itself isn't part of it
+    if(curr_pcb != NULL)
+        curr_pcb->saved_syscall = current_syscall;
+    current_syscall = 0;
+
+    // The terminal only says where the next process's I/O goes
+    current_pcb = next_pcb;
+    scheduled_terminal = next_pcb->terminal_id;
 
-    // Remap user program page 
-    set_user_prog_page(next_pcb->process_id, 1);
+    // Switch address spaces, the kernel mappings are shared by every directory
+    uint64_t cr3_start = rdtsc();
+    switch_page_directory(next_pcb->process_id);
+    sched_stats.cr3_cycles += (uint32_t)(rdtsc() - cr3_start);
 
     // Update TSS
-    tss.esp0 = EIGHT_MB - (next_pcb->process_id * EIGHT_KB) - 4;
+    tss.esp0 = PCB_ESP0(next_pcb);
     tss.ss0 = KERNEL_DS;
 
-    asm volatile(       //Switch to next process's stack
-        "movl %0, %%esp;"
-        "movl %1, %%ebp;"
-        : 
-        :"r"(next_pcb->curr_esp), "r"(next_pcb->curr_ebp) // Inputs
-        :"esp", "ebp"
-    );
-    
+    context_switch((curr_pcb != NULL) ? &curr_pcb->curr_esp : &boot_esp, next_pcb->curr_esp);
+
+    // Now running on the next process's stack, back where it called context_switch
+    current_syscall = current_pcb->saved_syscall;
+    uint32_t switch_cycles = (uint32_t)(rdtsc() - switch_start);
+    sched_stats.switches++;
+    sched_stats.switch_cycles += switch_cycles;
+    if(switch_cycles > sched_stats.max_switch_cycles)
+        sched_stats.max_switch_cycles = switch_cycles;
+}
+
+/*
+ * sched_tick
+ *    DESCRIPTION: Charges PIT ticks to the running process and reschedules when it's due
+ *    INPUTS: ticks -- 10ms ticks since the last call (1 for the fixed tick, the armed length
+ *                     of the one-shot when TICKLESS)
+ *    OUTPUTS: none
+ *    SIDE EFFECTS: See sched_charge
+ *    NOTES: Called by PIT_handler with interrupts off
+ */
+void sched_tick(uint32_t ticks) {
+    // Nothing switched in yet, start the first process
+    if(current_pcb == NULL) {
+        scheduler();
+        return;
+    }
+
+#ifdef TICKLESS
+    slice_start = rdtsc();      // The one-shot covered everything up to now
+#endif
+    if(sched_charge(current_pcb, ticks))
+        sched_need_resched = 1;
+
+    if(sched_need_resched)
+        scheduler();
+#ifdef TICKLESS
+    else
+        pit_arm(current_pcb->slice_left);   // Slice was longer than one one-shot can count
+#endif
+}
+
+/*
+ * sched_preempt
+ *    DESCRIPTION: Switches right away if an interrupt handler woke a process that outranks
+ *                 the running one, instead of waiting for the running one's slice to end
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    NOTES: Call at the end of an interrupt handler, after its EOI
+ */
+void sched_preempt() {
+    if(!sched_need_resched || sched_in_idle || current_pcb == NULL)
+        return;
+    sched_stats.wake_preempts++;
+    scheduler();
+}
+
+/*
+ * sched_interactive_boost
+ *    DESCRIPTION: Puts the running process at the best level its nice value allows,
+ *                 with a fresh slice
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    NOTES: For processes about to wait on the user, so they get the CPU as soon as input comes in
+ */
+void sched_interactive_boost() {
+    current_pcb->sched_level = current_pcb->nice;
+    current_pcb->slice_left = SCHED_SLICE(current_pcb->sched_level);
+#ifdef TICKLESS
+    current_pcb->slice_cycles = 0;  // The fresh slice starts now
+    slice_start = rdtsc();
+#endif
+}
+
+/*
+ * init_wait_queue
+ *    DESCRIPTION: Empties a wait queue
+ *    INPUTS: queue -- queue to initialize
+ *    OUTPUTS: none
+ */
+void init_wait_queue(wait_queue_t* queue) {
+    queue->head = NULL;
+    queue->tail = NULL;
+}
+
+/*
+ * sleep_on
+ *    DESCRIPTION: Blocks the running process on queue and switches to another one
+ *    INPUTS: queue -- queue to sleep on
+ *    OUTPUTS: none
+ *    SIDE EFFECTS: Returns once wake_up(queue) has run and the process is scheduled again
+ *    NOTES: Call with interrupts off, in a loop that rechecks the condition being waited for,
+ *           so a wakeup can't slip in between the check and going to sleep
+ */
+void sleep_on(wait_queue_t* queue) {
+    pcb_t * curr_pcb = current_pcb;
+
+    curr_pcb->state = PROC_BLOCKED;
+    curr_pcb->wait_next = NULL;
+    if(queue->tail == NULL)
+        queue->head = curr_pcb;
+    else
+        queue->tail->wait_next = curr_pcb;
+    queue->tail = curr_pcb;
+    sched_stats.blocks++;
+
+    scheduler();
+}
+
+/*
+ * wake_up
+ *    DESCRIPTION: Makes every process sleeping on queue runnable again
+ *    INPUTS: queue -- queue to wake up
+ *    OUTPUTS: none
+ *    NOTES: Safe to call from interrupt handlers, woken processes join the back of their level's
+ *           queue (call sched_preempt after the EOI to let one that outranks the running process in)
+ */
+void wake_up(wait_queue_t* queue) {
+    uint32_t flags;
+    pcb_t * pcb;
+
+    cli_and_save(flags);
+    for(pcb = queue->head; pcb != NULL; pcb = pcb->wait_next) {
+        run_queue_push(pcb);
+        pcb->wake_tsc = rdtsc();
+        if(current_pcb != NULL && pcb->sched_level < current_pcb->sched_level)
+            sched_need_resched = 1;
+        sched_stats.wakeups++;
+    }
+    queue->head = NULL;
+    queue->tail = NULL;
+    restore_flags(flags);
 }
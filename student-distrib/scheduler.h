@@ -1,7 +1,81 @@
 #ifndef _SCHEDULER_H
 #define _SCHEDULER_H
 
+#include "types.h"
+
+// Process states the scheduler cares about
+#define PROC_READY 0        // waiting on the run queue
+#define PROC_RUNNING 1      // on the CPU (current_pcb)
+#define PROC_BLOCKED 2      // sleeping on a wait queue, or in execute waiting for its child to halt
+#define PROC_ZOMBIE 3       // halted, its parent hasn't picked up the exit status yet
+
+// Multilevel feedback queue: level 0 runs first, a process that uses its whole slice drops a level
+#define SCHED_LEVELS 4
+#define SCHED_SLICE(level) (1 << (level))   // PIT ticks a process gets per turn at level
+#define SCHED_BOOST_TICKS 100               // every second everything moves back up to the top
+#define MAX_NICE (SCHED_LEVELS - 1)         // nice n keeps a process at level n or below
+
+// FIFO of processes sleeping until some event (keyboard line, RTC tick) happens
+typedef struct wait_queue {
+    struct pcb* head;
+    struct pcb* tail;
+} wait_queue_t;
+
+// Process that's on the CPU, NULL until the first one is switched in
+struct pcb* current_pcb;
+
+// Queues up the base shell of every terminal
+extern void init_scheduler();
+
+// Queues up a newly created process (see fork)
+extern void sched_add(struct pcb* pcb);
+
+// Puts the running process at the back of its queue (unless it's blocked) and runs the best ready one
 extern void scheduler();
 
+// Called from the PIT interrupt, switches when the running process's slice is used up
+extern void sched_tick(uint32_t ticks);
+
+// Moves every process back up to the best level its nice value allows (sched_tick does it periodically)
+extern void sched_boost_all();
+
+// Takes a ready process back off the run queue, -1 if it wasn't on it
+extern int32_t sched_dequeue(struct pcb* pcb);
+
+// Called by interrupt handlers after their EOI, switches if a wakeup outranks the running process
+extern void sched_preempt();
+
+// Moves the running process to the top level it's allowed before it waits on the user
+extern void sched_interactive_boost();
+
+// Empties a wait queue
+extern void init_wait_queue(wait_queue_t* queue);
+
+// Parks the running process on queue and runs something else until it's woken up
+extern void sleep_on(wait_queue_t* queue);
+
+// Makes every process on queue runnable again
+extern void wake_up(wait_queue_t* queue);
+
+// Set while the scheduler is halted waiting for a process to become runnable
+volatile uint32_t sched_in_idle;
+
+// Context switch latency, measured with the TSC from saving the old stack to running on the new one
+typedef struct sched_stats {
+    uint32_t switches;          // completed process switches
+    uint32_t switch_cycles;     // total cycles spent switching
+    uint32_t max_switch_cycles; // slowest switch seen
+    uint32_t cr3_cycles;        // part of switch_cycles spent loading the next page directory
+    uint32_t blocks;            // times a process went to sleep on a wait queue
+    uint32_t wakeups;           // processes woken up from wait queues
+    uint64_t idle_cycles;       // cycles spent halted because every process was blocked
+    uint32_t demotions;         // times a process used its whole slice and dropped a level
+    uint32_t wake_preempts;     // switches made right away because a wakeup outranked the running process
+    uint32_t wake_runs;         // woken processes that got back on the CPU
+    uint32_t wake_cycles;       // total cycles from wake_up to running again
+    uint32_t max_wake_cycles;   // longest wait from wake_up to running again
+} sched_stats_t;
+
+sched_stats_t sched_stats;
 
 #endif /* _SCHEDULER_H */
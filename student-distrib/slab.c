@@ -0,0 +1,219 @@
+/* slab.c - Object caches for fixed-size kernel objects
+ * vim:ts=4 noexpandtab
+ */
+
+/* Each cache carves slabs (4KB or 4MB frames from the frame allocator) into objects of one size.
+ * A slab starts with a slab_t header and keeps its free objects on a list threaded through the
+ * objects themselves, so allocating and freeing are a couple of pointer moves. Slabs are aligned
+ * to their size, which is how slab_free finds the header of an object. The cache files every slab
+ * on one of three lists (partial, full, empty) and always allocates from a partial slab first.
+ */
+
+#include "slab.h"
+#include "frames.h"
+#include "lib.h"
+
+/*
+ * slab_list_push
+ *    DESCRIPTION: Puts a slab at the head of one of a cache's lists
+ *    INPUTS: list -- head of the list
+ *            slab -- slab to add
+ *    RETURNS: none
+ */
+static void slab_list_push(slab_t** list, slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if(*list != NULL)
+        (*list)->prev = slab;
+    *list = slab;
+}
+
+/*
+ * slab_list_remove
+ *    DESCRIPTION: Takes a slab off the list it's on
+ *    INPUTS: list -- head of the list
+ *            slab -- slab to remove
+ *    RETURNS: none
+ */
+static void slab_list_remove(slab_t** list, slab_t* slab) {
+    if(slab->prev != NULL)
+        slab->prev->next = slab->next;
+    else
+        *list = slab->next;
+    if(slab->next != NULL)
+        slab->next->prev = slab->prev;
+    slab->prev = slab->next = NULL;
+}
+
+/*
+ * slab_create
+ *    DESCRIPTION: Gets a frame for a new slab and threads all of its objects onto the free list
+ *    INPUTS: cache -- cache the slab is for
+ *    RETURNS: the new slab, not on any list yet, or NULL if the frame allocator is out of memory
+ */
+static slab_t* slab_create(slab_cache_t* cache) {
+    slab_t *slab;
+    uint8_t *obj;
+    uint32_t i;
+
+    if(cache->slab_size == FOUR_KB)
+        slab = (slab_t*)frame_alloc();
+    else
+        slab = (slab_t*)frame_alloc_large();
+    if(slab == NULL)
+        return NULL;
+
+    slab->cache = cache;
+    slab->prev = slab->next = NULL;
+    slab->in_use = 0;
+    slab->free = NULL;
+
+    // Thread the list back to front so the lowest object is handed out first
+    obj = (uint8_t*)slab + cache->first_offset + cache->objs_per_slab * cache->obj_size;
+    for(i = 0; i < cache->objs_per_slab; i++) {
+        obj -= cache->obj_size;
+        *(void**)obj = slab->free;
+        slab->free = obj;
+    }
+
+    cache->stats.slabs++;
+    return slab;
+}
+
+/*
+ * slab_destroy
+ *    DESCRIPTION: Gives an empty slab's frame back to the frame allocator
+ *    INPUTS: cache -- cache the slab belongs to
+ *            slab -- slab to release, must not be on any list
+ *    RETURNS: none
+ */
+static void slab_destroy(slab_cache_t* cache, slab_t* slab) {
+    slab->cache = NULL;
+    if(cache->slab_size == FOUR_KB)
+        frame_put((uint32_t)slab);
+    else
+        frame_free_large((uint32_t)slab);
+    cache->stats.slabs--;
+}
+
+/*
+ * slab_cache_init
+ *    DESCRIPTION: Sets up an empty object cache
+ *    INPUTS: cache -- cache to set up
+ *            name -- name for debugging output
+ *            obj_size -- size of one object in bytes
+ *            align -- alignment every object needs (a power of two), raised to SLAB_CACHE_LINE
+ *    RETURNS: 0 on success, -1 if the alignment isn't a power of two or an object can't fit in a slab
+ *    SIDE EFFECTS: No memory is taken until the first slab_alloc()
+ *    NOTES: Objects go in 4KB slabs if SLAB_MIN_SMALL_OBJECTS of them fit in one, otherwise
+ *           (big or strictly aligned objects) in 4MB slabs
+ */
+int32_t slab_cache_init(slab_cache_t* cache, const int8_t* name, uint32_t obj_size, uint32_t align) {
+    if(obj_size == 0 || align == 0 || (align & (align - 1)) != 0)
+        return -1;
+    if(align < SLAB_CACHE_LINE)
+        align = SLAB_CACHE_LINE;
+    if(obj_size < sizeof(void*))
+        obj_size = sizeof(void*);
+
+    memset(cache, 0, sizeof(slab_cache_t));
+    cache->name = name;
+    cache->obj_size = (obj_size + align - 1) & ~(align - 1);
+    cache->first_offset = (sizeof(slab_t) + align - 1) & ~(align - 1);
+
+    cache->slab_size = FOUR_KB;
+    if(cache->first_offset + SLAB_MIN_SMALL_OBJECTS * cache->obj_size > FOUR_KB) {
+        cache->slab_size = FOUR_MB;
+        if(align > FOUR_MB / 2 || cache->obj_size > FOUR_MB - cache->first_offset)
+            return -1;
+    }
+    cache->objs_per_slab = (cache->slab_size - cache->first_offset) / cache->obj_size;
+    return 0;
+}
+
+/*
+ * slab_alloc
+ *    DESCRIPTION: Allocates one object
+ *    INPUTS: cache -- cache to allocate from
+ *    RETURNS: the object, or NULL if every slab is full and no frame is left for a new one
+ *    SIDE EFFECTS: The object's contents are not cleared
+ */
+void* slab_alloc(slab_cache_t* cache) {
+    uint32_t flags;
+    slab_t *slab;
+    void *obj;
+
+    cli_and_save(flags);
+    slab = cache->partial;
+    if(slab == NULL) {
+        if(cache->empty != NULL) {
+            slab = cache->empty;
+            slab_list_remove(&cache->empty, slab);
+            cache->num_empty--;
+        }
+        else if((slab = slab_create(cache)) == NULL) {
+            cache->stats.alloc_failures++;
+            restore_flags(flags);
+            return NULL;
+        }
+        slab_list_push(&cache->partial, slab);
+    }
+
+    obj = slab->free;
+    slab->free = *(void**)obj;
+    slab->in_use++;
+    if(slab->free == NULL) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_push(&cache->full, slab);
+    }
+
+    cache->stats.allocs++;
+    if(++cache->stats.in_use > cache->stats.peak_in_use)
+        cache->stats.peak_in_use = cache->stats.in_use;
+    restore_flags(flags);
+    return obj;
+}
+
+/*
+ * slab_free
+ *    DESCRIPTION: Returns an object to its slab
+ *    INPUTS: cache -- cache the object was allocated from
+ *            obj -- object to free, NULL is ignored
+ *    RETURNS: none
+ *    SIDE EFFECTS: A slab left empty is kept for reuse, or released if the cache already keeps
+ *                  SLAB_KEEP_EMPTY empty slabs
+ */
+void slab_free(slab_cache_t* cache, void* obj) {
+    uint32_t flags;
+    slab_t *slab;
+
+    if(obj == NULL)
+        return;
+    slab = (slab_t*)((uint32_t)obj & ~(cache->slab_size - 1));
+    if(slab->cache != cache)
+        return;
+
+    cli_and_save(flags);
+    if(slab->free == NULL) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+    *(void**)obj = slab->free;
+    slab->free = obj;
+    slab->in_use--;
+
+    if(slab->in_use == 0) {
+        slab_list_remove(&cache->partial, slab);
+        if(cache->num_empty < SLAB_KEEP_EMPTY) {
+            slab_list_push(&cache->empty, slab);
+            cache->num_empty++;
+        }
+        else {
+            slab_destroy(cache, slab);
+        }
+    }
+
+    cache->stats.frees++;
+    cache->stats.in_use--;
+    restore_flags(flags);
+}
@@ -0,0 +1,62 @@
+/* slab.h - Object caches for fixed-size kernel objects
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include "types.h"
+#include "x86_desc.h"
+
+// Every object starts on a cache line of its own
+#define SLAB_CACHE_LINE 64
+
+// A cache uses 4KB slabs if one holds at least this many of its objects, 4MB slabs otherwise
+#define SLAB_MIN_SMALL_OBJECTS 4
+
+// Empty slabs a cache holds on to before giving them back to the frame allocator
+#define SLAB_KEEP_EMPTY 1
+
+// Header at the start of every slab, the objects follow it
+typedef struct slab {
+    struct slab_cache* cache;   // cache the slab belongs to
+    struct slab* prev;          // neighbours on the cache's partial, full or empty list
+    struct slab* next;
+    void* free;                 // first free object, each free object holds a pointer to the next
+    uint32_t in_use;            // objects handed out from this slab
+} slab_t;
+
+// Usage counters kept per cache
+typedef struct slab_cache_stats {
+    uint32_t allocs;            // successful slab_alloc() calls
+    uint32_t frees;             // slab_free() calls
+    uint32_t in_use;            // objects currently allocated
+    uint32_t peak_in_use;       // most objects allocated at once
+    uint32_t slabs;             // slabs the cache currently holds
+    uint32_t alloc_failures;    // slab_alloc() calls that found no memory for a new slab
+} slab_cache_stats_t;
+
+// A cache of equally sized objects. Declare one per object type and set it up with slab_cache_init
+typedef struct slab_cache {
+    const int8_t* name;         // for debugging output
+    uint32_t obj_size;          // object size rounded up to the alignment
+    uint32_t slab_size;         // FOUR_KB or FOUR_MB, slabs are aligned to their size
+    uint32_t first_offset;      // offset of the first object from the start of a slab
+    uint32_t objs_per_slab;
+    slab_t* partial;            // slabs with free and allocated objects, allocation comes from here first
+    slab_t* full;               // slabs with no free objects
+    slab_t* empty;              // slabs with no allocated objects, at most SLAB_KEEP_EMPTY of them
+    uint32_t num_empty;
+    slab_cache_stats_t stats;
+} slab_cache_t;
+
+// Sets up an empty cache for objects of obj_size bytes aligned to align (at least a cache line)
+extern int32_t slab_cache_init(slab_cache_t* cache, const int8_t* name, uint32_t obj_size, uint32_t align);
+
+// Takes an object from the cache, returns NULL if no memory is left for a new slab
+extern void* slab_alloc(slab_cache_t* cache);
+
+// Gives an object back to the cache it came from
+extern void slab_free(slab_cache_t* cache, void* obj);
+
+#endif /* _SLAB_H */
@@ -0,0 +1,43 @@
+/* sysenter.c - Fast system call entry through SYSENTER/SYSEXIT
+ * vim:ts=4 noexpandtab
+ */
+
+/* int $0x80 goes through the IDT, pushes a full interrupt frame and leaves with iret.
+ * sysenter skips all of that: it loads CS, SS, EIP and ESP straight from MSRs and saves nothing,
+ * and sysexit goes back to the user EIP in EDX and ESP in ECX. Since those registers also carry
+ * syscall args, the user stub hands its return address in ESI and its stack in EBP instead, and
+ * sysenter_handler moves them over before sysexit. int $0x80 still works, programs opt in by
+ * calling the ece391_fast_* wrappers.
+ * (Intel SDM Vol. 2B SYSENTER/SYSEXIT, Vol. 3 5.8.7)
+ */
+
+#include "sysenter.h"
+#include "asm_linkage.h"
+#include "x86_desc.h"
+#include "lib.h"
+
+// Only used until sysenter_handler loads tss.esp0, and by an NMI that lands before that
+static uint8_t sysenter_stack[SYSENTER_STACK_SIZE] __attribute__((aligned(16)));
+
+/*
+ * init_sysenter
+ *    DESCRIPTION: Checks for SYSENTER/SYSEXIT and sets up the MSRs they load from
+ *    INPUTS/OUTPUTS: none
+ *    SIDE EFFECTS: Writes the IA32_SYSENTER_* MSRs, sets sysenter_enabled
+ *    NOTES: The GDT has the layout sysexit needs, USER_CS = KERNEL_CS + 16 and USER_DS = KERNEL_CS + 24
+ */
+void init_sysenter(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    asm volatile ("cpuid"
+            : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+            : "a"(1)
+    );
+    sysenter_enabled = (edx & CPUID_SEP) != 0;
+    if(!sysenter_enabled)
+        return;
+
+    wrmsr(IA32_SYSENTER_CS, KERNEL_CS);
+    wrmsr(IA32_SYSENTER_ESP, (uint32_t)(sysenter_stack + SYSENTER_STACK_SIZE));
+    wrmsr(IA32_SYSENTER_EIP, (uint32_t)&sysenter_handler);
+}
@@ -0,0 +1,22 @@
+/* sysenter.h - Fast system call entry through SYSENTER/SYSEXIT
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SYSENTER_H
+#define _SYSENTER_H
+
+#include "types.h"
+
+#define CPUID_SEP (1 << 11)             // CPUID.01H:EDX bit for SYSENTER/SYSEXIT support
+#define IA32_SYSENTER_CS 0x174          // kernel CS, SS is CS + 8 and the user ones are CS + 16 and CS + 24
+#define IA32_SYSENTER_ESP 0x175         // stack sysenter lands on, sysenter_handler leaves it right away
+#define IA32_SYSENTER_EIP 0x176         // where sysenter jumps to
+#define SYSENTER_STACK_SIZE 64
+
+// Set if the CPU has SYSENTER/SYSEXIT and the MSRs point at sysenter_handler
+uint32_t sysenter_enabled;
+
+// Points the SYSENTER MSRs at sysenter_handler if the CPU has them
+extern void init_sysenter(void);
+
+#endif /* _SYSENTER_H */
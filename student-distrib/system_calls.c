@@ -6,18 +6,30 @@
 #include "file_system.h"
 #include "terminal.h"
 #include "idt.h"
+#include "image_cache.h"
+#include "scheduler.h"
+#include "process.h"
+#include "asm_linkage.h"
+#include "pipe.h"
 
 /*fops tables for different types*/
-fops_jump_table_t rtc_table = {RTC_read, RTC_write, RTC_open, RTC_close};
-fops_jump_table_t directory_table = {read_dir, write_dir, open_dir, close_dir};
-fops_jump_table_t file_table = {read_file, write_file, open_file, close_file};
+fops_jump_table_t rtc_table = {RTC_read, RTC_write, RTC_open, RTC_close, fops_readv, fops_writev};
+fops_jump_table_t directory_table = {read_dir, write_dir, open_dir, close_dir, fops_readv, fops_writev};
+fops_jump_table_t file_table = {read_file, write_file, open_file, close_file, fops_readv, fops_writev};
 
-fops_jump_table_t stdin_table = {terminal_read,bad_call,bad_call,bad_call};
-fops_jump_table_t stdout_table = {bad_call,terminal_write,bad_call,bad_call};
+fops_jump_table_t stdin_table = {terminal_read,bad_call,bad_call,bad_call,fops_readv,bad_call};
+fops_jump_table_t stdout_table = {bad_call,terminal_write,bad_call,bad_call,bad_call,terminal_writev};
 
-fops_jump_table_t bad_table = {bad_call,bad_call,bad_call,bad_call};
+fops_jump_table_t bad_table = {bad_call,bad_call,bad_call,bad_call,bad_call,bad_call};
 
-uint32_t processes[MAX_PROCESSES] = {0, 0, 0, 0, 0, 0}; // Array of flags (should they be PCBs?) to track currently running processes
+fops_jump_table_t procstat_table = {procstat_read, procstat_write, procstat_open, procstat_close, fops_readv, fops_writev};
+
+fops_jump_table_t pipe_read_table = {pipe_read, bad_call, pipe_open, pipe_close, fops_readv, bad_call};
+fops_jump_table_t pipe_write_table = {bad_call, pipe_write, pipe_open, pipe_close, bad_call, fops_writev};
+
+static int32_t start_process(const uint8_t* command, int32_t base_shell);
+static int32_t discard_process(pcb_t* pcb, int32_t base_shell);
+static int32_t load_executable(pcb_t* pcb, const uint8_t* command, uint32_t* entry);
 
 
 
@@ -40,28 +52,64 @@ int32_t bad_call(){
  */
 int32_t halt(uint8_t status){
 
-    pcb_t *pcb_ptr =(pcb_t*)terminals[scheduled_terminal].terminal_pcb;  //initialize to current running terminal's pcb
+    // The scheduler can't be allowed to requeue a half torn down process
+    cli();
+
+    pcb_t *pcb_ptr = current_pcb;
 
     //initalize pcb
     int i;
-    for(i = 2; i < 8; i++) {
+    for(i = 0; i < 8; i++) {
         if(pcb_ptr->fda[i].flags==1){   //close any file descriptors in use
-            close(i);   
+            // Not through close(), stdin and stdout may be pipe ends that dup2 put there
+            pcb_ptr->fda[i].flags = 0;
+            pcb_ptr->fda[i].fops_table_ptr.close(i);
             pcb_ptr->fda[i].fops_table_ptr=bad_table;
         }    
     }
 
-    // Mark PID as free
-    processes[pcb_ptr->process_id] = 0;
-    terminals[scheduled_terminal].last_assigned_pid = pcb_ptr->parent_process_id;
+    // Give back the program page's frames (pages shared with other processes just lose a reference)
+    release_user_prog_table(pcb_ptr->process_id);
+    release_user_mmap_table(pcb_ptr->process_id);
+
+    // Nothing left but the exit status, and the process never gets back on the run queue
+    pcb_ptr->state = PROC_ZOMBIE;
+    acct_charge();      // Everything up to here was the child's
+
+    // Check for exceptions and return 256 if so
+    int32_t real_status;
+    if(exception_flag) {
+        exception_flag = 0;
+        real_status = 256;
+    }
+    else
+        real_status = status;
+
+    // Nobody is left to wait for the children this process forked
+    process_disown_children(pcb_ptr);
+
+    // A forked process leaves its status for its parent's wait and never runs again
+    if(pcb_ptr->forked) {
+        pcb_ptr->exit_status = real_status;
+        if(terminals[pcb_ptr->terminal_id].terminal_pcb == pcb_ptr)
+            terminals[pcb_ptr->terminal_id].terminal_pcb = pcb_ptr->parent_pcb;
+        if(pcb_ptr->parent_pcb != NULL) {
+            pcb_ptr->zombie_next = pcb_ptr->parent_pcb->zombies;
+            pcb_ptr->parent_pcb->zombies = pcb_ptr;
+            wake_up(&pcb_ptr->parent_pcb->child_wait);
+        }
+        else
+            process_free_later(pcb_ptr);
+        scheduler();
+    }
     
     // Check if we're at base shell and spawn new base shell if so
     if(pcb_ptr->parent_process_id == pcb_ptr->process_id){
-        execute((uint8_t*)"shell");
+        execute_base_shell(pcb_ptr->terminal_id);
     }
 
-    // restore paging
-    set_user_prog_page(pcb_ptr -> parent_process_id, 1);
+    // restore paging (the parent's directory still has its own vidmap state)
+    switch_page_directory(pcb_ptr -> parent_process_id);
     
     /* Close vidmap page if the halting process called it (scheduling will fuck this up)
     if(pcb_ptr->called_vidmap) {
@@ -70,25 +118,20 @@ int32_t halt(uint8_t status){
     } */
 
     // Update TSS to return to parent context
-    tss.esp0 = EIGHT_MB - (pcb_ptr -> parent_process_id * EIGHT_KB) - 4;    //setting ESP0 to base of new kernel stack
-    tss.ss0 = KERNEL_DS;    //setting SS0 to kernel data segment
-
-    // Check to see if parent called vidmap and turn it back on if so
     pcb_t *parent_pcb_ptr = pcb_ptr->parent_pcb;
-    if(parent_pcb_ptr->called_vidmap)
-        set_user_video_page(1);
+    tss.esp0 = PCB_ESP0(parent_pcb_ptr);    //setting ESP0 to base of parent's kernel stack
+    tss.ss0 = KERNEL_DS;    //setting SS0 to kernel data segment
 
-    // Terminal's PCB var should track parent process
-    terminals[scheduled_terminal].terminal_pcb = parent_pcb_ptr;
+    // The parent takes over the CPU (and the terminal's foreground) where the child left off
+    parent_pcb_ptr->state = PROC_RUNNING;
+    current_pcb = parent_pcb_ptr;
+    terminals[pcb_ptr->terminal_id].terminal_pcb = parent_pcb_ptr;
 
-    // Check for exceptions and return 256 if so
-    int32_t real_status;
-    if(exception_flag) {
-        exception_flag = 0;
-        real_status = 256;
-    }
-    else
-        real_status = status;
+    // Reap the child on the parent's behalf. This frees the stack we're on, but with interrupts
+    // off nothing can reuse it before the jump below leaves it
+    uint32_t parent_esp = pcb_ptr->parent_esp;
+    uint32_t parent_ebp = pcb_ptr->parent_ebp;
+    process_free(pcb_ptr);
 
     // Jump back to execute so we can return
     asm volatile(
@@ -98,7 +141,7 @@ int32_t halt(uint8_t status){
         "movl %2, %%eax;"
         "jmp EXECUTE_LABEL;"
         :       // Outputs
-        : "r"(pcb_ptr->parent_esp), "r"(pcb_ptr->parent_ebp), "r"(real_status) // Inputs
+        : "r"(parent_esp), "r"(parent_ebp), "r"(real_status) // Inputs
         : "eax" // Clobbers
     );
     return -1;      // Should never reach here
@@ -113,53 +156,42 @@ int32_t halt(uint8_t status){
  *    RETURNS: Returns code given by program, or -1 if unsuccessful
  */
 int32_t execute(const uint8_t* command){
-    
-    // Check null input 
-    if(command == NULL){
-        return -1;
-    }
-
-    // Find next available PID to assign
-    int i, next_pid; 
-    for(i = 0; i < MAX_PROCESSES; i++) {    //find next available process index
-        // If we've found a free PID, mark it and break from loop
-        if(processes[i] == 0) {
-            next_pid = i;
-            break;
-        }
-        // If we've reached end without finding a free PID, cannot execute
-        if(i == MAX_PROCESSES - 1)
-            return -1;
-    }
-
-    // Allocate PCB
-    // Calculate pointer to next PCB
-    pcb_t * next_pcb_ptr = (pcb_t *)(EIGHT_MB - ((next_pid + 1) * EIGHT_KB));
-
-    // Initialize every fda entry and activate stdin and stdout
-    for(i = 0; i < 2; i++) {
-        next_pcb_ptr->fda[i].inode = 0;
-        next_pcb_ptr->fda[i].file_pos = 0;
-        next_pcb_ptr->fda[i].flags = 1;
-    }
-    for(i = 2; i < 8; i++) {
-        next_pcb_ptr->fda[i].inode = 0;
-        next_pcb_ptr->fda[i].file_pos = 0;
-        next_pcb_ptr->fda[i].flags = 0;
-    }
+    return start_process(command, -1);
+}
 
-    // Set up fops tables for stdin and stdout respectively in the new pcb
-    next_pcb_ptr->fda[0].fops_table_ptr = stdin_table;
-    next_pcb_ptr->fda[1].fops_table_ptr = stdout_table;
+/*
+ * execute_base_shell
+ *    DESCRIPTION: Runs the base shell of a terminal
+ *    INPUTS: terminal_id -- terminal the shell belongs to
+ *    OUTPUTS: none
+ *    SIDE EFFECTS: The shell is its own parent and always gets pid terminal_id
+ *    RETURNS: never, halting a base shell starts a new one in its place
+ */
+void execute_base_shell(int32_t terminal_id){
+    start_process((uint8_t*)"shell", terminal_id);
+}
 
+/*
+ * load_executable
+ *    DESCRIPTION: Parses a command and checks that it names an executable, then points a PCB at it
+ *    INPUTS: pcb -- process that is going to run the executable
+ *            command -- the executable to run including its arguments
+ *            entry -- where to store the address of the program's first instruction
+ *    OUTPUTS: none
+ *    SIDE EFFECTS: On success, sets the PCB's arguments and the file that backs its image. On
+ *                  failure the PCB is left alone, so a failed exec leaves the caller intact
+ *    RETURNS: 0 on success, -1 if the file doesn't exist or isn't an executable
+ */
+static int32_t load_executable(pcb_t* pcb, const uint8_t* command, uint32_t* entry){
     // Parse command
     uint32_t command_length = strlen((int8_t *)command) + 1;    // Adding 1 allows us to add a NULL terminator
     uint8_t exec_name[command_length];
+    int8_t args[MAX_ARGS];
     dentry_t file_dentry;
+    uint32_t i = 0;
+    int j = 0;
 
     // Find command from entry (IMPORTANT: Strip leading spaces?)
-    i = 0;
-    int j = 0;
     memset(exec_name, '\0', command_length);    // Zero out exec_name
     while(command[i] != NULL && i < command_length){
         // Strip spaces before cmd
@@ -178,7 +210,7 @@ int32_t execute(const uint8_t* command){
 
     // Parse possible arguments (strips spaces between cmd and arg)
     j = 0;
-    memset(next_pcb_ptr->arg, '\0', MAX_ARGS);  // Zero out PCB's args array
+    memset(args, '\0', MAX_ARGS);  // Zero out the args array
     if(command[i] != NULL){
         i++;
         while(command[i] != NULL && i < command_length && j<MAX_ARGS){
@@ -187,7 +219,7 @@ int32_t execute(const uint8_t* command){
                 i++;
                 continue;
             }
-            next_pcb_ptr->arg[j] = command[i];
+            args[j] = command[i];
             i++;
             j++;
         }
@@ -200,88 +232,152 @@ int32_t execute(const uint8_t* command){
         return -1;
     }
 
-    // Copy program file to allocated page
-    // Allocate Page and flush TLB
-    set_user_prog_page(next_pid, 1); // Set present bit in execute and 0 in halt
-    
-    // Load executable into user page
-    int val = read_data(file_dentry.inode, 0, (uint8_t*)PROG_IMG_ADDR, 100000);
-    if(val == -1){
-        set_user_prog_page(next_pid, 0);
-        set_user_prog_page(terminals[scheduled_terminal].last_assigned_pid, 1);
+    // Read the ELF header once for both the executable check and the entry point
+    uint8_t elf_header[ELF_HEADER_LEN];
+    if(read_data(file_dentry.inode, 0, elf_header, ELF_HEADER_LEN) != ELF_HEADER_LEN)
         return -1;
-    }
 
     // Check ELF constant to see if file is an executable
-    uint8_t elf_check[4];
-    read_data(file_dentry.inode, 0, elf_check, 4);
-    if(elf_check[0] != 0x7f){
-        set_user_prog_page(next_pid, 0);
-        set_user_prog_page(terminals[scheduled_terminal].last_assigned_pid, 1);
+    if(elf_header[0] != 0x7f || elf_header[1] != 0x45 || elf_header[2] != 0x4c || elf_header[3] != 0x46)
         return -1;
-    }
-    if(elf_check[1] != 0x45){
-        set_user_prog_page(next_pid, 0);
-        set_user_prog_page(terminals[scheduled_terminal].last_assigned_pid, 1);
+
+    // Get addr exec's first instruction (bytes 24-27 of the exec file)
+    *entry = *((uint32_t*)(elf_header + ELF_ENTRY_OFFSET));
+
+    // Remember which file backs the image so pages can be (re)loaded from it
+    memcpy(pcb->arg, args, MAX_ARGS);
+    pcb->exec_inode = file_dentry.inode;
+    pcb->exec_size = fs_inode[file_dentry.inode].file_size;
+#ifdef USE_IMAGE_CACHE
+    pcb->exec_image = image_cache_get(file_dentry.inode);
+#else
+    pcb->exec_image = NULL;
+#endif
+
+    return 0;
+}
+
+/*
+ * start_process
+ *    DESCRIPTION: Does the work of execute
+ *    INPUTS: command -- the executable to run including its arguments
+ *            base_shell -- terminal whose base shell this is, or -1 for a child of the running process
+ *    OUTPUTS: none
+ *    SIDE EFFECTS: Copies program to corresponding page and runs it in place of the running
+ *                  process, which stays blocked until the child halts
+ *    RETURNS: Returns code given by program, or -1 if unsuccessful
+ */
+static int32_t start_process(const uint8_t* command, int32_t base_shell){
+    
+    // Check null input 
+    if(command == NULL){
         return -1;
     }
-    if(elf_check[2] != 0x4c){
-        set_user_prog_page(next_pid, 0);
-        set_user_prog_page(terminals[scheduled_terminal].last_assigned_pid, 1);
-        return -1;
+
+    // Base shells own the PIDs matching their terminals and keep their PCBs (init_scheduler makes
+    // them), everything else gets a new PID, PCB and kernel stack
+    int i, next_pid; 
+    pcb_t * next_pcb_ptr;
+    if(base_shell >= 0) {
+        next_pcb_ptr = pid_to_pcb(base_shell);
+        if(next_pcb_ptr == NULL && (next_pcb_ptr = process_alloc(base_shell)) == NULL)
+            return -1;
     }
-    if(elf_check[3] != 0x46){
-        set_user_prog_page(next_pid, 0);
-        set_user_prog_page(terminals[scheduled_terminal].last_assigned_pid, 1);
-        return -1;
+    else {
+        // If there's no free PID or no memory for the PCB and stack, cannot execute
+        if((next_pcb_ptr = process_alloc(-1)) == NULL)
+            return -1;
+    }
+    next_pid = next_pcb_ptr->process_id;
+
+    // Initialize every fda entry and activate stdin and stdout
+    for(i = 0; i < 2; i++) {
+        next_pcb_ptr->fda[i].inode = 0;
+        next_pcb_ptr->fda[i].file_pos = 0;
+        next_pcb_ptr->fda[i].flags = 1;
+        next_pcb_ptr->fda[i].pipe = NULL;
+    }
+    for(i = 2; i < 8; i++) {
+        next_pcb_ptr->fda[i].inode = 0;
+        next_pcb_ptr->fda[i].file_pos = 0;
+        next_pcb_ptr->fda[i].flags = 0;
+        next_pcb_ptr->fda[i].pipe = NULL;
+    }
+
+    // Set up fops tables for stdin and stdout respectively in the new pcb
+    next_pcb_ptr->fda[0].fops_table_ptr = stdin_table;
+    next_pcb_ptr->fda[1].fops_table_ptr = stdout_table;
+
+    // Find the executable and take its arguments
+    uint32_t prog_entry_addr;
+    if(load_executable(next_pcb_ptr, command, &prog_entry_addr) == -1)
+        return discard_process(next_pcb_ptr, base_shell);
+
+    // Map the program page with nothing loaded, the page fault handler fills in each 4KB on first touch
+    if(init_user_prog_table(next_pid) == -1)
+        return discard_process(next_pcb_ptr, base_shell);
+    release_user_mmap_table(next_pid);
+    init_process_dir(next_pid, (base_shell >= 0) ? base_shell : current_pcb->terminal_id);
+    switch_page_directory(next_pid);
+#ifndef LAZY_PROG_LOAD
+    // Eager loading: map the whole image now (pages of a cached image are shared, not copied)
+    if(populate_user_prog_image(next_pid, next_pcb_ptr) == -1) {
+        release_user_prog_table(next_pid);
+        switch_page_directory(current_pcb->process_id);
+        return discard_process(next_pcb_ptr, base_shell);
     }
+#endif
 
-    if(next_pid <= 2){    // base shell of terminal: assign given pid as both parent and process to denote base shell 
+    if(base_shell >= 0){    // base shell of terminal: assign given pid as both parent and process to denote base shell 
         next_pcb_ptr->parent_process_id = next_pid;
         next_pcb_ptr->process_id = next_pid;
+        next_pcb_ptr->parent_pcb = next_pcb_ptr;
+        next_pcb_ptr->terminal_id = base_shell;
+        next_pcb_ptr->nice = 0;
     }
     else{
-        next_pcb_ptr->parent_process_id = terminals[scheduled_terminal].last_assigned_pid;
+        next_pcb_ptr->parent_process_id = current_pcb->process_id;
         next_pcb_ptr->process_id = next_pid;
+        next_pcb_ptr->parent_pcb = current_pcb;     // Save existing PCB as parent
+        next_pcb_ptr->terminal_id = current_pcb->terminal_id;
+        next_pcb_ptr->nice = current_pcb->nice;
     }
 
-    // Mark PID as in use and set PCB
-    processes[next_pid] = 1;
-    terminals[scheduled_terminal].last_assigned_pid = next_pid;
-
-    
     // Initialize vidmap flag
     next_pcb_ptr->called_vidmap = 0;
+    next_pcb_ptr->saved_syscall = 0;
+    next_pcb_ptr->wait_next = NULL;
+    next_pcb_ptr->run_next = NULL;
+    next_pcb_ptr->sched_level = next_pcb_ptr->nice;     // New processes start at the top they're allowed
+    next_pcb_ptr->slice_left = SCHED_SLICE(next_pcb_ptr->sched_level);
+    next_pcb_ptr->wake_tsc = 0;
+    next_pcb_ptr->forked = 0;
+    next_pcb_ptr->forked_children = 0;
+    next_pcb_ptr->zombies = NULL;
+    init_wait_queue(&next_pcb_ptr->child_wait);
+    acct_init(&next_pcb_ptr->acct);
     
-    // Get addr exec's first instruction (bytes 24-27 of the exec file)
-    uint8_t prog_entry_buf[4];
-    uint32_t prog_entry_addr;
-    read_data(file_dentry.inode, 24, prog_entry_buf, 4);
-    prog_entry_addr = *((uint32_t*)prog_entry_buf);
-
     // Prepare TSS for context switch
-    tss.esp0 = EIGHT_MB - (next_pid * EIGHT_KB) - 4;    //setting ESP0 to base of new kernel stack
+    tss.esp0 = PCB_ESP0(next_pcb_ptr);    //setting ESP0 to base of new kernel stack
     tss.ss0 = KERNEL_DS;    //setting SS0 to kernel data segment
-    
-    // If we're executing the first base shells for the terminals, the scheduler already got their ESP/EBP
-    if(next_pid <= 2){
-        next_pcb_ptr->curr_esp = terminals[scheduled_terminal].terminal_pcb->curr_esp;
-        next_pcb_ptr->curr_ebp = terminals[scheduled_terminal].terminal_pcb->curr_ebp;
-    }
-    // Otherwise, the scheduler will put the exec's ESP/EBP into the PCB later
-    else{
-        next_pcb_ptr->curr_esp = NULL;
-        next_pcb_ptr->curr_ebp = NULL;
-    }
+
+    cli();
+    acct_charge();      // Execute's work so far belongs to the parent
+
+    // The child runs in place of the parent, which sits out of the run queue until the child halts
+    // (a restarted base shell is replacing itself)
+    if(current_pcb != next_pcb_ptr)
+        current_pcb->state = PROC_BLOCKED;
+    next_pcb_ptr->state = PROC_RUNNING;
+    current_pcb = next_pcb_ptr;
+    terminals[next_pcb_ptr->terminal_id].terminal_pcb = next_pcb_ptr;   // Terminal's foreground process
+    acct_enter_user();
     
     // Save state of current/parent stack into PCB
     asm volatile ("movl %%esp, %0;"
                   "movl %%ebp, %1;"
                 : "=r" (next_pcb_ptr->parent_esp), "=r" (next_pcb_ptr->parent_ebp)    // Outputs
     );
-
-    next_pcb_ptr->parent_pcb = terminals[scheduled_terminal].terminal_pcb; // Save existing PCB as parent
-    terminals[scheduled_terminal].terminal_pcb = next_pcb_ptr; // Update pcb pointer for current terminal
     
     // Push items to stack and context switch using IRET
     asm volatile (
@@ -314,6 +410,21 @@ int32_t execute(const uint8_t* command){
     return retval;
 }
 
+/*
+ * discard_process
+ *    DESCRIPTION: Backs out of a start_process that failed before the program ran
+ *    INPUTS: pcb -- PCB start_process was filling in
+ *            base_shell -- start_process's base_shell argument
+ *    OUTPUTS: none
+ *    SIDE EFFECTS: A child's PID, PCB, stack and page tables are freed, a base shell keeps its own
+ *    RETURNS: Always -1, for start_process to return
+ */
+static int32_t discard_process(pcb_t* pcb, int32_t base_shell){
+    if(base_shell < 0)
+        process_free(pcb);
+    return -1;
+}
+
 
 /*
  * read
@@ -326,7 +437,7 @@ int32_t execute(const uint8_t* command){
  */
 int32_t read(int32_t fd, void* buf, int32_t nbytes){
     sti();
-    pcb_t *pcb = (pcb_t*)(tss.esp0  & 0xFFFFE000); //ANDing the process's ESP register w/ appropriate bit mask to reach top of stack
+    pcb_t *pcb = current_pcb;
     if(fd<0 || fd>7 || pcb->fda[fd].flags == 0) //check for valid fd index, max 8 files
         return -1;
 
@@ -349,7 +460,7 @@ int32_t read(int32_t fd, void* buf, int32_t nbytes){
  */
 int32_t write(int32_t fd, const void* buf, int32_t nbytes){
     
-    pcb_t *pcb=(pcb_t*)(tss.esp0  & 0xFFFFE000);    //temp placeholder until we figure out how to initialize the pcb
+    pcb_t *pcb=current_pcb;
     if(fd<0 || fd>7 || pcb->fda[fd].flags == 0) //check for valid fd index, max 8 files
         return -1;
 
@@ -368,12 +479,16 @@ int32_t write(int32_t fd, const void* buf, int32_t nbytes){
  */
 int32_t open(const uint8_t* filename){
     
-    pcb_t *pcb=(pcb_t*)(tss.esp0  & 0xFFFFE000);    //temp placeholder until we figure out how to initialize the pcb
+    pcb_t *pcb=current_pcb;
     if(filename==NULL)  //check for valid file
         return -1;
 
+    // procstat is served by the kernel, there's no dentry for it
+    uint32_t is_procstat = (strlen((int8_t*)filename) == strlen(PROCSTAT_NAME) &&
+                            strncmp((int8_t*)filename, PROCSTAT_NAME, strlen(PROCSTAT_NAME)) == 0);
+
     dentry_t dentry;
-    if(read_dentry_by_name(filename,&dentry)==-1)   //check if file exists within dentry
+    if(!is_procstat && read_dentry_by_name(filename,&dentry)==-1)   //check if file exists within dentry
         return -1;
     
 
@@ -396,6 +511,11 @@ int32_t open(const uint8_t* filename){
     if(available==0)             //if no available space is found, fail
         return -1;
     
+    if(is_procstat){
+        pcb->fda[i].fops_table_ptr=procstat_table;
+        return i;
+    }
+
     uint32_t file_type = dentry.ftype;
     if(file_type==0){   //ftype 0 for RTC
         pcb->fda[i].fops_table_ptr=rtc_table;
@@ -421,7 +541,7 @@ int32_t open(const uint8_t* filename){
  */
 int32_t close(int32_t fd){
     
-    pcb_t* pcb=(pcb_t*)(tss.esp0  & 0xFFFFE000); //temp placeholder until we figure out how to initialize the pcb
+    pcb_t* pcb=current_pcb;
     
     if(fd<2 || fd>7 || pcb->fda[fd].flags == 0) //check for valid fd index, max 8 files
         return -1;
@@ -441,7 +561,7 @@ int32_t close(int32_t fd){
  */
 int32_t getargs(uint8_t * buf, int32_t nbytes) {
     
-    pcb_t *pcb=(pcb_t*)(tss.esp0  & 0xFFFFE000);
+    pcb_t *pcb=current_pcb;
 
     // Check for valid buf and bytes to be read, or no args were passed
     if(buf==NULL || nbytes < MAX_ARGS || pcb->arg[0] == '\0')
@@ -468,7 +588,7 @@ int32_t vidmap(uint8_t ** screen_start) {
     }
     
     // Mark that the process called vidmap
-    pcb_t *pcb=(pcb_t*)(tss.esp0  & 0xFFFFE000);
+    pcb_t *pcb=current_pcb;
     pcb->called_vidmap = 1;
 
     // Set the page entry and copy the VirtMem address to user space
@@ -492,3 +612,381 @@ int32_t set_handler(int32_t signum, void* handler_address) {
 int32_t sigreturn(void) {
     return -1;
 }
+
+/*
+ * nice
+ *    DESCRIPTION: Sets the nice value of the calling process
+ *    INPUTS: value -- 0 (default) to MAX_NICE, the process never runs at a better level than this
+ *    OUTPUTS: none
+ *    SIDE EFFECTS: Children executed afterwards inherit the value
+ *    RETURNS: 0 on success, -1 on fail
+ */
+int32_t nice(int32_t value) {
+    if(value < 0 || value > MAX_NICE)
+        return -1;
+
+    current_pcb->nice = value;
+    if(current_pcb->sched_level < current_pcb->nice)
+        current_pcb->sched_level = current_pcb->nice;
+
+    return 0;
+}
+
+/*
+ * readv
+ *    DESCRIPTION: Reads into several buffers with one syscall, filling them in order
+ *    INPUTS: fd -- file descriptor to read
+ *            iov -- buffers to fill
+ *            iovcnt -- number of buffers, at most IOV_MAX
+ *    OUTPUTS: data read goes into the buffers
+ *    RETURNS: Total bytes read, or -1 if the first read fails
+ */
+int32_t readv(int32_t fd, const iovec_t* iov, int32_t iovcnt) {
+    pcb_t *pcb=current_pcb;
+    if(fd<0 || fd>7 || pcb->fda[fd].flags == 0) //check for valid fd index, max 8 files
+        return -1;
+
+    if(iov==NULL || iovcnt<0 || iovcnt>IOV_MAX)
+        return -1;
+
+    return pcb->fda[fd].fops_table_ptr.readv(fd, iov, iovcnt);
+}
+
+/*
+ * writev
+ *    DESCRIPTION: Writes several buffers with one syscall, in order
+ *    INPUTS: fd -- file descriptor to write
+ *            iov -- buffers to write
+ *            iovcnt -- number of buffers, at most IOV_MAX
+ *    OUTPUTS: none
+ *    RETURNS: Total bytes written, or -1 if the first write fails
+ */
+int32_t writev(int32_t fd, const iovec_t* iov, int32_t iovcnt) {
+    pcb_t *pcb=current_pcb;
+    if(fd<0 || fd>7 || pcb->fda[fd].flags == 0) //check for valid fd index, max 8 files
+        return -1;
+
+    if(iov==NULL || iovcnt<0 || iovcnt>IOV_MAX)
+        return -1;
+
+    return pcb->fda[fd].fops_table_ptr.writev(fd, iov, iovcnt);
+}
+
+/*
+ * fops_readv
+ *    DESCRIPTION: readv for any file, calls its read once per buffer
+ *    INPUTS: same as readv
+ *    OUTPUTS: data read goes into the buffers
+ *    RETURNS: Total bytes read, or -1 if the first read fails
+ *    NOTES: Stops after a read that comes up short, the next one would have to wait or hit the end
+ */
+int32_t fops_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt) {
+    pcb_t *pcb=current_pcb;
+    int32_t i, n, total = 0;
+
+    for(i = 0; i < iovcnt; i++) {
+        n = pcb->fda[fd].fops_table_ptr.read(fd, iov[i].base, iov[i].len);
+        if(n < 0)
+            return (total == 0) ? -1 : total;
+        total += n;
+        if(n < iov[i].len)
+            break;
+    }
+    return total;
+}
+
+/*
+ * fops_writev
+ *    DESCRIPTION: writev for any file, calls its write once per buffer
+ *    INPUTS: same as writev
+ *    OUTPUTS: none
+ *    RETURNS: Total bytes written, or -1 if the first write fails
+ *    NOTES: Stops after a write that comes up short
+ */
+int32_t fops_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt) {
+    pcb_t *pcb=current_pcb;
+    int32_t i, n, total = 0;
+
+    for(i = 0; i < iovcnt; i++) {
+        n = pcb->fda[fd].fops_table_ptr.write(fd, iov[i].base, iov[i].len);
+        if(n < 0)
+            return (total == 0) ? -1 : total;
+        total += n;
+        if(n < iov[i].len)
+            break;
+    }
+    return total;
+}
+
+/*
+ * mmap
+ *    DESCRIPTION: Maps an open regular file read-only into the caller's address space
+ *    INPUTS: fd -- file descriptor of the file
+ *            addr -- where to put the user address of the file's first byte
+ *    OUTPUTS: *addr, NULL for an empty file
+ *    RETURNS: Size of the file in bytes, or -1 if fd isn't a regular file or it couldn't be mapped
+ *    NOTES: Writing to the mapping is a page fault that ends the program. The file
+ *           position is untouched, and closing fd leaves the mapping in place
+ */
+int32_t mmap(int32_t fd, void** addr) {
+    pcb_t *pcb=current_pcb;
+    uint32_t size, user_addr = 0;
+
+    if(fd<2 || fd>7 || pcb->fda[fd].flags == 0 || pcb->fda[fd].fops_table_ptr.read != read_file)
+        return -1;
+
+    // Verify that addr is within the user-level page (128MB-132MB)
+    if((uint32_t)addr > ONE_THREE_TWO_MB - sizeof(void*) || (uint32_t)addr < ONE_TWO_EIGHT_MB)
+        return -1;
+
+    size = fs_inode[pcb->fda[fd].inode].file_size;
+    if(size != 0) {
+        user_addr = mmap_file(pcb->process_id, pcb->fda[fd].inode);
+        if(user_addr == 0)
+            return -1;
+    }
+
+    *addr = (void*)user_addr;
+    return size;
+}
+
+/*
+ * munmap
+ *    DESCRIPTION: Removes a mapping made by mmap
+ *    INPUTS: addr -- address mmap gave back
+ *    OUTPUTS: none
+ *    RETURNS: 0 on success, -1 if addr isn't the start of a mapping
+ */
+int32_t munmap(void* addr) {
+    pcb_t *pcb=current_pcb;
+    return munmap_pages(pcb->process_id, (uint32_t)addr);
+}
+
+/*
+ * fork
+ *    DESCRIPTION: Creates a copy of the running process that runs next to it
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURNS: The child's PID in the parent, 0 in the child, -1 if there was no PID or memory
+ *    SIDE EFFECTS: The child shares the parent's user pages copy-on-write, gets a copy of its file
+ *                  descriptors (each with its own file position) and goes on the run queue. It
+ *                  starts out returning from this same syscall
+ *    NOTES: Only reachable through INT $0x80, the child's kernel stack is a copy of that frame
+ */
+int32_t fork(void) {
+    pcb_t *parent = current_pcb, *child;
+    uint32_t *parent_top, *stack, saved_esp;
+    int i;
+
+    if((child = process_alloc(-1)) == NULL)
+        return -1;
+    if(fork_user_pages(parent->process_id, child->process_id, parent->terminal_id) == -1) {
+        process_free(child);
+        return -1;
+    }
+
+    memcpy(child->fda, parent->fda, sizeof(parent->fda));
+    for(i = 0; i < 8; i++)
+        pipe_dup(&child->fda[i]);
+    memcpy(child->arg, parent->arg, MAX_ARGS);
+    child->exec_inode = parent->exec_inode;
+    child->exec_size = parent->exec_size;
+    child->exec_image = parent->exec_image;
+    child->called_vidmap = parent->called_vidmap;
+
+    child->parent_process_id = parent->process_id;
+    child->parent_pcb = parent;
+    child->terminal_id = parent->terminal_id;
+    child->forked = 1;
+    child->nice = parent->nice;
+    child->sched_level = child->nice;
+    child->slice_left = SCHED_SLICE(child->sched_level);
+    init_wait_queue(&child->child_wait);
+    acct_init(&child->acct);
+
+    // Copy the parent's systems_handler frame (its user registers and the iret back to user
+    // space), pointing the frame's saved esp at the child's copy
+    parent_top = (uint32_t*)PCB_ESP0(parent);
+    stack = (uint32_t*)PCB_ESP0(child);
+    for(i = 1; i <= SYSCALL_FRAME_WORDS; i++)
+        stack[-i] = parent_top[-i];
+    stack -= SYSCALL_FRAME_WORDS;
+    saved_esp = (uint32_t)stack;
+    *(--stack) = saved_esp;
+
+    // Lay out the frame context_switch pops, returning into fork_child_return
+    *(--stack) = (uint32_t)fork_child_return;
+    *(--stack) = 0;     // ebp
+    *(--stack) = 0;     // ebx
+    *(--stack) = 0;     // esi
+    *(--stack) = 0;     // edi
+    child->curr_esp = (uint32_t)stack;
+
+    parent->forked_children++;
+    sched_add(child);
+    return child->process_id;
+}
+
+/*
+ * exec
+ *    DESCRIPTION: Replaces the running program with another one, in the same process
+ *    INPUTS: command -- executable to run and its arguments, as for execute
+ *    OUTPUTS: none
+ *    RETURNS: Doesn't return on success, -1 if command isn't an executable (the old program goes on)
+ *    SIDE EFFECTS: The old image, its mmaps and its vidmap page are dropped. The PID, parent,
+ *                  forked children and open files all stay
+ */
+int32_t exec(const uint8_t* command) {
+    pcb_t *pcb = current_pcb;
+    uint32_t prog_entry_addr;
+
+    if(command == NULL)
+        return -1;
+
+    // Nothing is torn down until the new program is known to be an executable
+    if(load_executable(pcb, command, &prog_entry_addr) == -1)
+        return -1;
+
+    cli();
+    release_user_prog_table(pcb->process_id);
+    release_user_mmap_table(pcb->process_id);
+    if(pcb->called_vidmap) {
+        set_user_video_page(0);
+        pcb->called_vidmap = 0;
+    }
+    switch_page_directory(pcb->process_id);     // reloading CR3 drops the old image's translations
+#ifndef LAZY_PROG_LOAD
+    // The old image is gone, so there's nothing to go back to
+    if(populate_user_prog_image(pcb->process_id, pcb) == -1)
+        halt_wrapper();
+#endif
+
+    acct_syscall_exit();
+    current_syscall = 0;
+
+    // Start the new image like execute does, on an empty kernel stack
+    asm volatile (
+        "movl %0, %%esp;"
+        "movl %2, %%ds;"
+        "pushl %2;"                 //push USER_DS, 0x2B
+        "pushl $0x083ffffc;"        // Set ESP to point to the user page (132MB - 4B)
+        "pushfl;"                   //push flags
+        "popl %%eax;"
+        "orl $0x200, %%eax;"        //sets bit 9 to 1 in the flags register to sti
+        "pushl %%eax;"
+        "pushl %3;"                 //push USER_CS, 0x23
+        "pushl %1;"                 // Push the addr of exec's first instruction for EIP
+        "iret;"
+        :                       // No Outputs
+        : "r"(PCB_ESP0(pcb)), "r"(prog_entry_addr), "r"(USER_DS), "r"(USER_CS)      // Inputs
+        : "eax"                     // Clobbers
+    );
+    return -1;      // Should never reach here
+}
+
+/*
+ * wait
+ *    DESCRIPTION: Reaps a forked child of the running process, sleeping until one halts
+ *    INPUTS: status -- where to put the child's halt status (256 if it died on an exception), or NULL
+ *    OUTPUTS: The status into *status
+ *    RETURNS: PID of the reaped child, -1 if the process has no forked children left
+ *    SIDE EFFECTS: The child's PID, PCB and kernel stack are freed
+ */
+int32_t wait(int32_t* status) {
+    pcb_t *pcb = current_pcb, *child;
+    uint32_t flags, pid;
+    int32_t exit_status;
+
+    if(status != NULL && ((uint32_t)status > ONE_THREE_TWO_MB - sizeof(int32_t) || (uint32_t)status < ONE_TWO_EIGHT_MB))
+        return -1;
+
+    cli_and_save(flags);
+    while((child = pcb->zombies) == NULL) {
+        if(pcb->forked_children == 0) {
+            restore_flags(flags);
+            return -1;
+        }
+        sleep_on(&pcb->child_wait);
+    }
+    pcb->zombies = child->zombie_next;
+    pcb->forked_children--;
+    pid = child->process_id;
+    exit_status = child->exit_status;
+    process_free(child);
+    restore_flags(flags);
+
+    if(status != NULL)
+        *status = exit_status;
+    return pid;
+}
+
+/*
+ * pipe
+ *    DESCRIPTION: Creates a pipe and opens both of its ends
+ *    INPUTS: fds -- where to put the two file descriptors
+ *    OUTPUTS: The read end's descriptor into fds[0] and the write end's into fds[1]
+ *    RETURNS: 0 on success, -1 if fds isn't in the user page, there aren't two free file
+ *             descriptors, or there's no memory for the pipe
+ *    SIDE EFFECTS: Reads and writes block until the other end catches up, see pipe.c
+ */
+int32_t pipe(int32_t* fds) {
+    pcb_t *pcb=current_pcb;
+    int32_t read_fd, write_fd;
+    pipe_t *p;
+
+    // Verify that fds is within the user-level page (128MB-132MB)
+    if((uint32_t)fds > ONE_THREE_TWO_MB - 2 * sizeof(int32_t) || (uint32_t)fds < ONE_TWO_EIGHT_MB)
+        return -1;
+
+    // 0 and 1 stay stdin and stdout, dup2 can move the ends there
+    for(read_fd = 2; read_fd < 8 && pcb->fda[read_fd].flags == 1; read_fd++);
+    for(write_fd = read_fd + 1; write_fd < 8 && pcb->fda[write_fd].flags == 1; write_fd++);
+    if(write_fd >= 8)
+        return -1;
+
+    if((p = pipe_alloc()) == NULL)
+        return -1;
+
+    pcb->fda[read_fd].fops_table_ptr = pipe_read_table;
+    pcb->fda[read_fd].inode = 0;
+    pcb->fda[read_fd].file_pos = 0;
+    pcb->fda[read_fd].flags = 1;
+    pcb->fda[read_fd].pipe = p;
+
+    pcb->fda[write_fd].fops_table_ptr = pipe_write_table;
+    pcb->fda[write_fd].inode = 0;
+    pcb->fda[write_fd].file_pos = 0;
+    pcb->fda[write_fd].flags = 1;
+    pcb->fda[write_fd].pipe = p;
+
+    fds[0] = read_fd;
+    fds[1] = write_fd;
+    return 0;
+}
+
+/*
+ * dup2
+ *    DESCRIPTION: Makes newfd refer to the same file as oldfd
+ *    INPUTS: oldfd -- open file descriptor to copy
+ *            newfd -- descriptor to put the copy in, stdin and stdout included
+ *    OUTPUTS: none
+ *    RETURNS: newfd on success, -1 if either descriptor is out of range or oldfd isn't open
+ *    SIDE EFFECTS: Whatever newfd had open is closed first. A copied pipe end counts as one more
+ *                  descriptor on that end, other files get their own file position
+ */
+int32_t dup2(int32_t oldfd, int32_t newfd) {
+    pcb_t *pcb=current_pcb;
+
+    if(oldfd<0 || oldfd>7 || newfd<0 || newfd>7 || pcb->fda[oldfd].flags == 0)
+        return -1;
+    if(oldfd == newfd)
+        return newfd;
+
+    if(pcb->fda[newfd].flags == 1) {
+        pcb->fda[newfd].flags = 0;
+        pcb->fda[newfd].fops_table_ptr.close(newfd);
+    }
+    pcb->fda[newfd] = pcb->fda[oldfd];
+    pipe_dup(&pcb->fda[newfd]);
+    return newfd;
+}
@@ -2,9 +2,21 @@
 #define _SYSTEM_CALLS_H
 
 #include "types.h"
+#include "acct.h"
+#include "scheduler.h"
 
-#define MAX_PROCESSES 6
+#define MAX_PIDS 1024            // size of the PID space, PIDs below MAX_TERMINALS belong to the base shells
 #define MAX_ARGS 100
+#define ELF_HEADER_LEN 28       // Bytes of the ELF header execute() needs (magic + entry point)
+#define ELF_ENTRY_OFFSET 24     // Entry point address lives in bytes 24-27 of the ELF header
+#define IOV_MAX 16              // Most buffers one readv/writev takes
+#define SYSCALL_FRAME_WORDS 11  // Words systems_handler's frame takes on the kernel stack (iret frame and saved registers)
+
+// One buffer of a readv/writev, same layout as the user side's ece391_iovec
+typedef struct iovec {
+    void* base;
+    int32_t len;
+} iovec_t;
 
 //Appendix A 8.2, fops table should contain entries for open, read, write, and close
 //Note: functions are casted to pointers, otherwise C won't recognize them in struct
@@ -13,6 +25,8 @@ typedef struct{
     int32_t (*write)(int32_t fd, const void* buf, int32_t nbytes);
     int32_t (*open)(const uint8_t* filename);
     int32_t (*close)(int32_t fd);
+    int32_t (*readv)(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+    int32_t (*writev)(int32_t fd, const iovec_t* iov, int32_t iovcnt);
 } fops_jump_table_t;
 
 
@@ -22,6 +36,7 @@ typedef struct file_descriptor_t {
     uint32_t inode;
     uint32_t file_pos; 
     uint32_t flags;     //marks whether is in use
+    struct pipe* pipe;  // pipe behind a pipe end, NULL for other files
 } file_descriptor_t;
 
 //Process control block (PCB) struct described in Appendix A 8.2
@@ -31,13 +46,36 @@ typedef struct pcb {
     uint32_t parent_process_id;
     uint32_t parent_esp;
     uint32_t parent_ebp;
-    uint32_t curr_esp;
-    uint32_t curr_ebp;
+    uint32_t curr_esp;          // kernel esp saved by context_switch while this process isn't on the CPU
     uint8_t called_vidmap;
     int8_t arg[MAX_ARGS];             // holds the arguments passed by the shell cmd 
     struct pcb * parent_pcb;
+    uint32_t exec_inode;        // inode of the running executable (demand loading reads from it)
+    uint32_t exec_size;         // size in bytes of the running executable
+    struct image_cache_entry* exec_image;   // cached copy of the executable, NULL if not cached
+    uint32_t saved_syscall;     // current_syscall while this process isn't scheduled
+    uint32_t state;             // PROC_READY, PROC_RUNNING, PROC_BLOCKED or PROC_ZOMBIE (see scheduler.h)
+    struct pcb * wait_next;     // next process on the wait queue this one sleeps on
+    struct pcb * run_next;      // next process on the run queue
+    int32_t terminal_id;        // terminal the process reads and writes (inherited from its parent)
+    uint32_t nice;              // best scheduler level the process may reach, set with the nice syscall
+    uint32_t sched_level;       // current scheduler level, 0 runs first (see scheduler.h)
+    uint32_t slice_left;        // PIT ticks left in the process's turn
+    uint32_t slice_cycles;      // TSC cycles it ran short of a whole tick, charged once they add up (TICKLESS)
+    uint64_t wake_tsc;          // TSC when wake_up made it ready, 0 if it wasn't woken
+    proc_acct_t acct;           // CPU time and syscall counts (see acct.h)
+    uint32_t kernel_stack;      // lowest address of the process's kernel stack (see process.h)
+    uint32_t forked;            // made by fork (runs next to its parent, reaped with wait), not execute
+    int32_t exit_status;        // halt status of a forked process, for its parent's wait
+    uint32_t forked_children;   // forked children that haven't been waited for yet
+    struct pcb * zombies;       // forked children that halted and wait for their parent to reap them
+    struct pcb * zombie_next;   // next process on the parent's zombie list
+    wait_queue_t child_wait;    // where wait sleeps until a forked child halts
 }pcb_t;
 
+// Number of the syscall the running process is in, 0 outside of syscalls (set by systems_handler)
+uint32_t current_syscall;
+
 
 
 //static uint32_t last_assigned_pid;      //keeps track of current pid
@@ -46,6 +84,9 @@ int32_t bad_call();
 
 void bootup_terminals();
 
+// Starts (or restarts) the base shell of terminal_id in the running context, never returns
+void execute_base_shell(int32_t terminal_id);
+
 /*required functions for CP3/CP4, function formats in Appendix B*/
 int32_t halt(uint8_t status);
 
@@ -67,4 +108,28 @@ int32_t set_handler(int32_t signum, void* handler_address);
 
 int32_t sigreturn(void);
 
+int32_t nice(int32_t value);
+
+int32_t readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
+int32_t writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
+int32_t mmap(int32_t fd, void** addr);
+
+int32_t munmap(void* addr);
+
+int32_t fork(void);
+
+int32_t exec(const uint8_t* command);
+
+int32_t wait(int32_t* status);
+
+int32_t pipe(int32_t* fds);
+
+int32_t dup2(int32_t oldfd, int32_t newfd);
+
+// readv/writev for files with no vectored op of their own, one read/write per buffer
+int32_t fops_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+int32_t fops_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
 #endif /* _SYSTEM_CALLS_H */
@@ -22,33 +22,34 @@ void init_terminal(){
     scheduled_terminal = 0;
     visible_terminal = 0;
     for(i = 0; i < MAX_TERMINALS; i++) {    
-        terminals[i].terminal_pcb = NULL;      // will be implemented in scheduler
+        terminals[i].terminal_pcb = NULL;      // set once the base shell is executed
         terminals[i].terminal_id = i;
         terminals[i].cursor_x = 0;
         terminals[i].cursor_y = 0;
-        terminals[i].last_assigned_pid = -1;   // flag as no process running
         terminals[i].rtc_freq = 0;             // Set RTC freq for that terminal to 0Hz (set later by RTC_open and write)
         terminals[i].rtc_active = 0;
         terminals[i].rtc_countdown = 0;
         terminals[i].rtc_virt_interrupt = 0;
+        init_wait_queue(&terminals[i].kb_wait);
+        init_wait_queue(&terminals[i].rtc_wait);
         clear_keyboard_vars(i);                 // Initialize each terminal's keyboard buffer 
     }
 }
 
 /*
- * clear_keyboard_buf
- *    DESCRIPTION: Zeros keyboard buffer, resets enter flag and buffer index
+ * clear_keyboard_vars
+ *    DESCRIPTION: Empties the terminal's keyboard ring
  *    INPUTS: terminal_id -- the terminal whose keyboard vars are to be reset   
+ *    NOTES: Only safe while the keyboard handler and terminal_read can't be using the ring
  */
 void clear_keyboard_vars(int32_t terminal_id) {
     if(terminal_id < 0 || terminal_id >= MAX_TERMINALS)
         return;
-    int i;      // Loop index
-    terminals[terminal_id].kb_buf_i = 0;
-    terminals[terminal_id].kb_enter_flag = 0;
-    for(i = 0; i < KEYBOARD_BUF_SIZE; i++) {
-        terminals[terminal_id].kb_buf[i] = 0;
-    }
+    terminals[terminal_id].kb_head = 0;
+    terminals[terminal_id].kb_tail = 0;
+    terminals[terminal_id].kb_edit = 0;
+    terminals[terminal_id].kb_cursor = 0;
+    terminals[terminal_id].kb_history_pos = terminals[terminal_id].kb_history_count;
 }
 
 /*
@@ -77,11 +78,12 @@ int32_t terminal_close(int32_t fd) {
 
 /*
  * terminal_read
- *    DESCRIPTION: Reads from the buffer 
- *    INPUTS: file descriptor, buf -- ptr to output buffer that we copy keyboard_buf to, n_bytes
- *    OUTPUTS: copies buf to terminal_buf
+ *    DESCRIPTION: Reads the next typed line of the terminal
+ *    INPUTS: file descriptor, buf -- ptr to output buffer that we copy the line to, n_bytes
+ *    OUTPUTS: copies up to n_bytes of the line, '\n' included, to buf
  *    RETURN VALUE: Number of bytes written
- *    SIDE EFFECTS: Writes to buffer pointed to by input
+ *    SIDE EFFECTS: Sleeps until a line has been entered. Lines typed ahead stay queued for
+ *                  later reads, as does the rest of a line longer than n_bytes
  */
 int32_t terminal_read(int32_t fd, void * buf, int32_t n_bytes) {
     
@@ -89,38 +91,36 @@ int32_t terminal_read(int32_t fd, void * buf, int32_t n_bytes) {
     if(buf == 0 || n_bytes <= 0)
         return 0; 
 
-    // Let keyboard know how many bytes the buffer is (is this meaningless?)
-    terminal_buf_n_bytes = n_bytes;
-
-    // Block until enter ('\n') has been pressed for the scheduled terminal
-    while(!terminals[scheduled_terminal].kb_enter_flag);
+    // Using scheduled_terminal as we might be in a background process
+    terminal_t * term = &terminals[scheduled_terminal];
 
-    // Alias vars for readability (using scheduled_terminal as we might be in a background process)
-    char * kb_buf = terminals[scheduled_terminal].kb_buf;
-    volatile int32_t * kb_buf_i = &terminals[scheduled_terminal].kb_buf_i;
-    
-    // Return value var as we clear the terminal's keyboard info at the end
-    int32_t bytes_written;
-
-    // Strip any extraneous chars after '\n' due to race cond in issue #18's reopen
-    if(kb_buf_i > 0) { 
-        if(kb_buf[*kb_buf_i - 1] != '\n') {
-            kb_buf[*kb_buf_i - 1] = '\0';
-            (*kb_buf_i)--; // decrement index of kb
-        }
+    // Sleep until a line has been entered in this terminal (the keyboard handler wakes us)
+    uint32_t flags;
+    cli_and_save(flags);
+    // Waiting on the user makes this an interactive process, so it goes to the top level
+    while(term->kb_head == term->kb_tail) {
+        sched_interactive_boost();
+        sleep_on(&term->kb_wait);
     }
+    restore_flags(flags);
 
-    // Copy keyboard buf to input buf
-    (void)strncpy((int8_t *)buf, (int8_t *)kb_buf, n_bytes);
+    // Everything before kb_head is finished lines the handler won't touch again
+    uint32_t head = term->kb_head;
+    uint32_t tail = term->kb_tail;
+    int32_t bytes_read = 0;
+    char c;
+    asm volatile ("" ::: "memory");     // Read kb_head before the chars it covers
 
-    // Copy keyboard_buf index, which is the same as the number of bytes read from keyboard_buf including '\n'
-    bytes_written = *kb_buf_i;
+    do {
+        c = term->kb_ring[tail & KEYBOARD_RING_MASK];
+        tail++;
+        ((char *)buf)[bytes_read++] = c;
+    } while(c != '\n' && tail != head && bytes_read < n_bytes);
 
-    // Reset so the keyboard buffer can write to its normal size
-    terminal_buf_n_bytes = KEYBOARD_BUF_SIZE;
-    clear_keyboard_vars(scheduled_terminal);
+    asm volatile ("" ::: "memory");     // Done with the chars before handing their slots back
+    term->kb_tail = tail;
 
-    return bytes_written;
+    return bytes_read;
 }
 
 /*
@@ -129,22 +129,44 @@ int32_t terminal_read(int32_t fd, void * buf, int32_t n_bytes) {
  *    INPUTS: buf -- bytes to write to screen
  *    OUTPUTS: none
  *    RETURN VALUE: number of bytes/chars written to screen
- *    SIDE EFFECTS: writes to video memory using putc
+ *    SIDE EFFECTS: renders the whole buffer into the scheduled terminal's text in one pass
  */
 int32_t terminal_write(int32_t fd, const void * buf, int32_t n_bytes) {
 
-    int i;      // Loop index
-
     // NULL check input
     if(buf == 0 || n_bytes < 0)
         return -1;
 
-    // Print n_bytes worth of chars
-    for(i = 0; i < n_bytes; i++) {
-        putc(((char *)(buf))[i], 0);
+    return write_screen(scheduled_terminal, (const int8_t*)buf, n_bytes);
+}
+
+/*
+ * terminal_writev
+ *    DESCRIPTION: Writes several buffers to the screen
+ *    INPUTS: fd -- ignored
+ *            iov -- buffers to write, in order
+ *            iovcnt -- number of buffers
+ *    OUTPUTS: none
+ *    RETURN VALUE: Total bytes written, or -1 if the first buffer is bad
+ *    SIDE EFFECTS: Interrupts stay off across the buffers, so nothing else
+ *                  printed to the terminal can land between them
+ */
+int32_t terminal_writev(int32_t fd, const iovec_t * iov, int32_t iovcnt) {
+    uint32_t flags;
+    int32_t i, total = 0;
+
+    cli_and_save(flags);
+    for(i = 0; i < iovcnt; i++) {
+        if(iov[i].base == 0 || iov[i].len < 0) {
+            if(total == 0)
+                total = -1;
+            break;
+        }
+        total += write_screen(scheduled_terminal, (const int8_t*)iov[i].base, iov[i].len);
     }
+    restore_flags(flags);
 
-    return i;
+    return total;
 }
 
 /*
@@ -7,25 +7,41 @@
 
 #include "keyboard.h"
 #include "types.h"
+#include "scheduler.h"
 
 #define MAX_TERMINALS 3
 
+struct iovec;       // see system_calls.h
+
 typedef struct{
-    struct pcb* terminal_pcb;
+    struct pcb* terminal_pcb;           // foreground process, the last one executed in this terminal
     int32_t terminal_id;                //keeps track of which terminal we are on
     int32_t cursor_x;
     int32_t cursor_y;
-    int32_t last_assigned_pid;          //keeps track of last assigned pid of the terminal
 
-    volatile int32_t kb_buf_i;          // This terminal's keyboard buffer index
-    volatile char kb_enter_flag;        //flags whether the kb enter key has been used
-    char kb_buf[KEYBOARD_BUF_SIZE];     // This terminal's keyboard buffer
+    // Typed input, a single-producer (keyboard handler) single-consumer (terminal_read) ring.
+    // Indices run freely and wrap with KEYBOARD_RING_MASK. The handler writes the line being
+    // typed at [kb_head, kb_edit) and publishes it by moving kb_head past its '\n', so
+    // [kb_tail, kb_head) only ever holds complete lines. Each side only stores its own index.
+    char kb_ring[KEYBOARD_RING_SIZE];
+    volatile uint32_t kb_head;          // end of the complete lines, written by the handler
+    volatile uint32_t kb_tail;          // next char to read, written by terminal_read
+    uint32_t kb_edit;                   // end of the line being typed, private to the handler
+    uint32_t kb_cursor;                 // where typing goes in [kb_head, kb_edit], private to the handler
+
+    // Lines entered in this terminal, for up/down. Entry i is at i & KEYBOARD_HISTORY_MASK
+    char kb_history[KEYBOARD_HISTORY_SIZE][KEYBOARD_BUF_SIZE];
+    uint32_t kb_history_count;          // lines ever saved
+    uint32_t kb_history_pos;            // entry on the line being typed, kb_history_count for a new line
 
     volatile uint8_t rtc_active;                 // Boolean that denotes if this terminal's process opened the RTC
     volatile uint8_t rtc_virt_interrupt;         // Flag that denotes that the virtual RTC interrupt has occurred
     uint32_t rtc_freq;                  // RTC frequency for this terminal (virtualization purposes)
     uint32_t rtc_countdown;    // Holds number of interrupts which at 1024Hz is equivalent to rtc_freq
 
+    wait_queue_t kb_wait;               // Processes sleeping in terminal_read until enter is pressed
+    wait_queue_t rtc_wait;              // Processes sleeping in RTC_read until the virtual RTC ticks
+
 }terminal_t;
 
 
@@ -61,6 +77,9 @@ int32_t terminal_read(int32_t fd, void * buf, int32_t n_bytes);
 // Writes to the screen from buf and returns num bytes written or -1
 int32_t terminal_write(int32_t fd, const void * buf, int32_t n_bytes);
 
+// Writes several buffers to the screen in one go and returns total bytes written or -1
+int32_t terminal_writev(int32_t fd, const struct iovec * iov, int32_t iovcnt);
+
 // Switches to the desired terminal
 void switch_visible_terminal(int32_t terminal_id);
 
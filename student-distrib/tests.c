@@ -6,6 +6,13 @@
 #include "terminal.h"
 #include "paging.h"
 #include "system_calls.h"
+#include "frames.h"
+#include "slab.h"
+#include "process.h"
+#include "pipe.h"
+#include "scheduler.h"
+#include "tlb.h"
+#include "pit.h"
 
 #define PASS 1
 #define FAIL 0
@@ -263,6 +270,94 @@ int test_terminal_keyboard(){
 	return PASS;
 }
 
+/*
+ * test_keyboard_ring
+ *    DESCRIPTION: Types two lines ahead into the keyboard ring and reads them back
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUES: PASS if both lines come back in order, the second one across two short reads
+ *    SIDE EFFECTS: Empties the scheduled terminal's keyboard ring
+ */
+int test_keyboard_ring(){
+	TEST_HEADER;
+	char buf[8];
+	char * typed = "ls\ncat x\n";
+	int result = PASS;
+	int i;
+
+	clear_keyboard_vars(scheduled_terminal);
+	for(i = 0; typed[i] != '\0'; i++) {
+		if(typed[i] == '\n')
+			keyboard_end_line(scheduled_terminal);
+		else
+			keyboard_put_char(scheduled_terminal, typed[i]);
+	}
+
+	if(terminal_read(0, buf, sizeof(buf)) != 3 || strncmp(buf, "ls\n", 3))
+		result = FAIL;
+	if(terminal_read(0, buf, 4) != 4 || strncmp(buf, "cat ", 4))
+		result = FAIL;
+	if(terminal_read(0, buf, sizeof(buf)) != 2 || strncmp(buf, "x\n", 2))
+		result = FAIL;
+
+	clear_keyboard_vars(scheduled_terminal);
+	return result;
+}
+
+/*
+ * test_keyboard_translate
+ *    DESCRIPTION: Runs scan code sequences through the decoder and edits a line at a moved cursor
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUES: PASS if shift, caps lock, ctrl and extended codes decode right and a char
+ *                   typed mid-line lands at the cursor
+ *    SIDE EFFECTS: Empties the scheduled terminal's keyboard ring, leaves caps lock as it was
+ */
+int test_keyboard_translate(){
+	TEST_HEADER;
+	// a, shift+a, caps+a, caps+shift+a, ctrl+l, up, fake shift then up, keypad enter, right ctrl+l
+	uint8_t codes[] = {
+		0x1E, 0x9E,
+		0x2A, 0x1E, 0x9E, 0xAA,
+		0x3A, 0xBA, 0x1E, 0x9E,
+		0x36, 0x1E, 0x9E, 0xB6,
+		0x3A, 0xBA,
+		0x1D, 0x26, 0xA6, 0x9D,
+		0xE0, 0x48, 0xE0, 0xC8,
+		0xE0, 0x2A, 0xE0, 0x48, 0xE0, 0xC8, 0xE0, 0xAA,
+		0xE0, 0x1C, 0xE0, 0x9C,
+		0xE0, 0x1D, 0x26, 0xA6, 0xE0, 0x9D
+	};
+	uint8_t expected[] = {'a', 'A', 'A', 'a', KEY_CTRL_L, KEY_UP, KEY_UP, '\n', KEY_CTRL_L};
+	uint8_t key;
+	char buf[8];
+	int result = PASS;
+	int i, n = 0;
+
+	for(i = 0; i < sizeof(codes); i++) {
+		key = keyboard_translate(codes[i]);
+		if(key == 0)
+			continue;
+		if(n >= sizeof(expected) || key != expected[n++])
+			result = FAIL;
+	}
+	if(n != sizeof(expected))
+		result = FAIL;
+
+	// "ct" with the cursor moved back one, then 'a', reads as "cat"
+	clear_keyboard_vars(scheduled_terminal);
+	keyboard_put_char(scheduled_terminal, 'c');
+	keyboard_put_char(scheduled_terminal, 't');
+	terminals[scheduled_terminal].kb_cursor--;
+	keyboard_put_char(scheduled_terminal, 'a');
+	keyboard_end_line(scheduled_terminal);
+	if(terminal_read(0, buf, sizeof(buf)) != 4 || strncmp(buf, "cat\n", 4))
+		result = FAIL;
+
+	clear_keyboard_vars(scheduled_terminal);
+	return result;
+}
+
 /* Checkpoint 3 (MP3.3) tests */
 
 
@@ -272,6 +367,716 @@ int test_terminal_keyboard(){
 /* Checkpoint 5 (MP3.5) tests */
 
 
+/* Performance benchmarks */
+
+// Number of times each benchmark repeats its measured operation
+#define BENCH_ITERATIONS 16
+// Large enough to hold the biggest file in the image (fish is ~36KB)
+#define BENCH_BUF_SIZE (40 * ONE_KB)
+
+// The filesystem only stores the first 32 chars of this file's name
+#define LARGE_TEXT_FNAME "verylargetextwithverylongname.tx"
+
+static uint8_t bench_buf_old[BENCH_BUF_SIZE];
+static uint8_t bench_buf_new[BENCH_BUF_SIZE];
+
+/*
+ * read_data_bytewise
+ *    DESCRIPTION: The original byte-at-a-time read_data loop, kept only as a benchmark baseline
+ *    INPUTS/OUTPUTS: same as read_data
+ *    NOTES: Re-derives the data block pointer for every byte copied
+ */
+static int32_t read_data_bytewise(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+	if(buf==NULL || inode >= boot->num_inodes)
+		return 0;
+
+	inode_t* curr_inode=(inode_t*)(&(fs_inode[inode]));
+	if(offset >= curr_inode->file_size)
+		return 0;
+
+	int bytes_read;
+	data_block_t* curr_data_block;
+	for(bytes_read=0; bytes_read<length; bytes_read++){
+		if((offset) > curr_inode->file_size)
+			break;
+		curr_data_block=(data_block_t*)(fs_data_block + (curr_inode->index_num[offset/BLOCK_SIZE]));
+		buf[bytes_read]=curr_data_block->block[offset%BLOCK_SIZE];
+		offset++;
+	}
+	return bytes_read;
+}
+
+/*
+ * bench_read_file
+ *    DESCRIPTION: Times reading a whole file with the old and new read_data paths
+ *    INPUTS: fname -- file to read
+ *    OUTPUTS: prints average cycles per full-file read for each path
+ *    RETURN VALUES: PASS if both paths produce identical data, FAIL otherwise
+ */
+static int bench_read_file(int8_t* fname){
+	dentry_t dentry;
+	uint32_t file_size, i;
+	int32_t old_bytes = 0, new_bytes = 0;
+	uint64_t start;
+	uint32_t old_cycles = 0, new_cycles = 0;
+
+	if(read_dentry_by_name((uint8_t*)fname, &dentry) == -1){
+		printf("%s not found\n", fname);
+		return FAIL;
+	}
+	file_size = fs_inode[dentry.inode].file_size;
+	if(file_size > BENCH_BUF_SIZE)
+		file_size = BENCH_BUF_SIZE;
+
+	for(i = 0; i < BENCH_ITERATIONS; i++){
+		start = rdtsc();
+		old_bytes = read_data_bytewise(dentry.inode, 0, bench_buf_old, file_size);
+		old_cycles += (uint32_t)(rdtsc() - start);
+
+		start = rdtsc();
+		new_bytes = read_data(dentry.inode, 0, bench_buf_new, file_size);
+		new_cycles += (uint32_t)(rdtsc() - start);
+	}
+
+	printf("%s (%u B): bytewise %u cycles, block-run %u cycles\n", fname, file_size,
+		old_cycles / BENCH_ITERATIONS, new_cycles / BENCH_ITERATIONS);
+
+	if(old_bytes != new_bytes)
+		return FAIL;
+	for(i = 0; i < new_bytes; i++){
+		if(bench_buf_old[i] != bench_buf_new[i])
+			return FAIL;
+	}
+	return PASS;
+}
+
+/*
+ * read_data_benchmark
+ *    DESCRIPTION: Compares cycle counts of the bytewise and block-run read_data paths
+ *    INPUTS: none
+ *    OUTPUTS: prints cycle counts for a large text file and a large executable
+ *    RETURN VALUES: PASS if both paths agree on every byte, FAIL otherwise
+ *    SIDE EFFECTS: none
+ */
+int read_data_benchmark(){
+	TEST_HEADER;
+	int result = PASS;
+	dentry_t dentry;
+
+	if(bench_read_file((int8_t*)LARGE_TEXT_FNAME) == FAIL)
+		result = FAIL;
+	if(bench_read_file((int8_t*)"fish") == FAIL)
+		result = FAIL;
+
+	// Reading at EOF must return 0 and a read that runs past EOF must stop at the last byte
+	if(read_dentry_by_name((uint8_t*)"frame0.txt", &dentry) == -1)
+		return FAIL;
+	if(read_data(dentry.inode, fs_inode[dentry.inode].file_size, bench_buf_new, 1) != 0)
+		result = FAIL;
+	if(read_data(dentry.inode, 0, bench_buf_new, BENCH_BUF_SIZE) != fs_inode[dentry.inode].file_size)
+		result = FAIL;
+	return result;
+}
+
+
+/*
+ * read_dentry_by_name_linear
+ *    DESCRIPTION: The original linear-scan dentry lookup, kept only as a benchmark baseline
+ *    INPUTS/OUTPUTS: same as read_dentry_by_name
+ */
+static int32_t read_dentry_by_name_linear(const uint8_t* fname, dentry_t* dentry){
+	if(fname==NULL||dentry==NULL||strlen((int8_t*)fname) > 32)
+		return -1;
+
+	int i;
+	for(i=0;i<boot->num_dentries;i++){
+		if(!strncmp((int8_t*)&(boot->dentries[i]),(int8_t*)fname,FNAME_LENGTH)){
+			strncpy((int8_t*)dentry->fname, (int8_t*)boot->dentries[i].fname,FNAME_LENGTH);
+			dentry->ftype=boot->dentries[i].ftype;
+			dentry->inode=boot->dentries[i].inode;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/*
+ * dentry_lookup_benchmark
+ *    DESCRIPTION: Measures average TSC cycles per read_dentry_by_name hit and miss
+ *    INPUTS: none
+ *    OUTPUTS: prints average cycles for hashed and linear lookups
+ *    RETURN VALUES: PASS if every dentry is found (and agrees with the linear scan) and
+ *                   every bogus name misses, FAIL otherwise
+ *    SIDE EFFECTS: none
+ */
+int dentry_lookup_benchmark(){
+	TEST_HEADER;
+	char * misses[] = {"nosuchfile", "shel", "shell2", "ls ", "frame2.txt",
+		"verylargetextwithverylongname.tz", "SHELL", "x"};
+	uint32_t num_misses = sizeof(misses) / sizeof(misses[0]);
+	uint8_t name[FNAME_LENGTH + 1];
+	dentry_t dentry, linear_dentry;
+	uint32_t i, j, lookups;
+	uint64_t start;
+	uint32_t hit_cycles = 0, miss_cycles = 0, linear_hit_cycles = 0, linear_miss_cycles = 0;
+	int result = PASS;
+
+	lookups = 0;
+	for(j = 0; j < BENCH_ITERATIONS; j++){
+		for(i = 0; i < boot->num_dentries; i++){
+			// Dentry names are not NUL-terminated when they use all 32 chars
+			memcpy(name, boot->dentries[i].fname, FNAME_LENGTH);
+			name[FNAME_LENGTH] = '\0';
+
+			start = rdtsc();
+			if(read_dentry_by_name(name, &dentry) == -1)
+				result = FAIL;
+			hit_cycles += (uint32_t)(rdtsc() - start);
+
+			start = rdtsc();
+			(void)read_dentry_by_name_linear(name, &linear_dentry);
+			linear_hit_cycles += (uint32_t)(rdtsc() - start);
+
+			if(dentry.inode != linear_dentry.inode || dentry.ftype != linear_dentry.ftype)
+				result = FAIL;
+			lookups++;
+		}
+	}
+	if(lookups)
+		printf("hit:  hashed %u cycles, linear %u cycles (avg of %u)\n",
+			hit_cycles / lookups, linear_hit_cycles / lookups, lookups);
+
+	lookups = 0;
+	for(j = 0; j < BENCH_ITERATIONS; j++){
+		for(i = 0; i < num_misses; i++){
+			start = rdtsc();
+			if(read_dentry_by_name((uint8_t*)misses[i], &dentry) != -1)
+				result = FAIL;
+			miss_cycles += (uint32_t)(rdtsc() - start);
+
+			start = rdtsc();
+			(void)read_dentry_by_name_linear((uint8_t*)misses[i], &linear_dentry);
+			linear_miss_cycles += (uint32_t)(rdtsc() - start);
+			lookups++;
+		}
+	}
+	printf("miss: hashed %u cycles, linear %u cycles (avg of %u)\n",
+		miss_cycles / lookups, linear_miss_cycles / lookups, lookups);
+
+	return result;
+}
+
+/*
+ * test_frame_refcounts
+ *    DESCRIPTION: Checks that shared frames stay allocated until their last reference is dropped
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUES: PASS if refcounts and the free frame count behave, FAIL otherwise
+ *    SIDE EFFECTS: Allocates and frees two frames and a large frame
+ */
+int test_frame_refcounts(){
+	TEST_HEADER;
+	uint32_t free_before = frame_stats.free_frames;
+	uint32_t a = frame_alloc();
+	uint32_t b = frame_alloc();
+	uint32_t large;
+	int result = PASS;
+
+	if(a == 0 || b == 0 || a == b)
+		return FAIL;
+	frame_get(a);		// a is now shared by two mappings
+	if(frame_refcount(a) != 2 || frame_refcount(b) != 1)
+		result = FAIL;
+	frame_put(a);
+	if(frame_refcount(a) != 1 || frame_stats.free_frames != free_before - 2)
+		result = FAIL;
+	frame_put(a);
+	frame_put(b);
+	if(frame_refcount(a) != 0 || frame_stats.free_frames != free_before)
+		result = FAIL;
+	large = frame_alloc_large();
+	// Large frames (e.g. image cache chunks) come out of the same pool but are never counted
+	if(large != 0) {
+		if(frame_refcount(large) != 0 || frame_stats.free_frames != free_before - FRAMES_PER_LARGE)
+			result = FAIL;
+		frame_get(large);
+		frame_put(large);
+		frame_free_large(large);
+		if(frame_refcount(large) != 0 || frame_stats.free_frames != free_before)
+			result = FAIL;
+	}
+
+	return result;
+}
+
+#define SLAB_TEST_OBJ_SIZE 40
+#define SLAB_BENCH_OBJECTS 256
+
+static slab_cache_t test_small_cache;
+static slab_cache_t test_large_cache;
+static slab_cache_t bench_slab_cache;
+static void* slab_bench_objs[SLAB_BENCH_OBJECTS];
+
+/*
+ * test_slab_cache
+ *    DESCRIPTION: Fills a small-object cache past one slab, frees everything, and checks an
+ *                 8KB-aligned cache gets 4MB slabs
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUES: PASS if objects are aligned and distinct, slabs are added and given back as
+ *                   the stats say, and freed objects are reused, FAIL otherwise
+ *    SIDE EFFECTS: Allocates and frees frames (one empty slab per cache stays cached)
+ */
+int test_slab_cache(){
+	TEST_HEADER;
+	uint32_t i, per_slab, free_before = frame_stats.free_frames;
+	void *first, *big;
+	int result = PASS;
+
+	if(slab_cache_init(&test_small_cache, "test_small", SLAB_TEST_OBJ_SIZE, 4) != 0)
+		return FAIL;
+	per_slab = test_small_cache.objs_per_slab;
+	if(test_small_cache.obj_size != SLAB_CACHE_LINE || test_small_cache.slab_size != FOUR_KB ||
+	   per_slab + 1 > SLAB_BENCH_OBJECTS)
+		return FAIL;
+
+	// One more object than a slab holds needs a second slab
+	for(i = 0; i < per_slab + 1; i++){
+		slab_bench_objs[i] = slab_alloc(&test_small_cache);
+		if(slab_bench_objs[i] == NULL || ((uint32_t)slab_bench_objs[i] & (SLAB_CACHE_LINE - 1)) != 0)
+			return FAIL;
+		if(i > 0 && slab_bench_objs[i] == slab_bench_objs[i - 1])
+			result = FAIL;
+	}
+	if(test_small_cache.stats.slabs != 2 || test_small_cache.stats.in_use != per_slab + 1 ||
+	   frame_stats.free_frames != free_before - 2)
+		result = FAIL;
+
+	// Emptying both slabs keeps one and gives the other back
+	first = slab_bench_objs[0];
+	for(i = 0; i < per_slab + 1; i++)
+		slab_free(&test_small_cache, slab_bench_objs[i]);
+	if(test_small_cache.stats.slabs != SLAB_KEEP_EMPTY || test_small_cache.stats.in_use != 0 ||
+	   test_small_cache.stats.peak_in_use != per_slab + 1 ||
+	   frame_stats.free_frames != free_before - SLAB_KEEP_EMPTY)
+		result = FAIL;
+	slab_bench_objs[0] = slab_alloc(&test_small_cache);
+	if((((uint32_t)slab_bench_objs[0] ^ (uint32_t)first) & ~(FOUR_KB - 1)) != 0)
+		result = FAIL;		// should come from the kept slab, the one first was in
+	slab_free(&test_small_cache, slab_bench_objs[0]);
+
+	// Kernel-stack sized objects get 4MB slabs and keep their alignment
+	if(slab_cache_init(&test_large_cache, "test_large", EIGHT_KB, EIGHT_KB) != 0)
+		return FAIL;
+	if(test_large_cache.slab_size != FOUR_MB || test_large_cache.objs_per_slab != FOUR_MB / EIGHT_KB - 1)
+		result = FAIL;
+	big = slab_alloc(&test_large_cache);
+	if(big != NULL){
+		if(((uint32_t)big & (EIGHT_KB - 1)) != 0)
+			result = FAIL;
+		slab_free(&test_large_cache, big);
+	}
+
+	return result;
+}
+
+/*
+ * slab_alloc_benchmark
+ *    DESCRIPTION: Times slab_alloc and slab_free with a few and with many objects outstanding,
+ *                 next to frame_alloc and frame_put for the same number of 4KB frames
+ *    INPUTS: none
+ *    OUTPUTS: prints average cycles per call
+ *    RETURN VALUES: PASS if every allocation succeeded, FAIL otherwise
+ *    SIDE EFFECTS: Leaves one empty slab in the benchmark cache
+ */
+int slab_alloc_benchmark(){
+	TEST_HEADER;
+	uint32_t i, alloc_cycles, free_cycles, frame_cycles, put_cycles;
+	uint64_t start;
+
+	if(slab_cache_init(&bench_slab_cache, "bench", SLAB_TEST_OBJ_SIZE, 4) != 0)
+		return FAIL;
+
+	start = rdtsc();
+	for(i = 0; i < SLAB_BENCH_OBJECTS; i++)
+		if((slab_bench_objs[i] = slab_alloc(&bench_slab_cache)) == NULL)
+			return FAIL;
+	alloc_cycles = (uint32_t)(rdtsc() - start);
+	start = rdtsc();
+	for(i = 0; i < SLAB_BENCH_OBJECTS; i++)
+		slab_free(&bench_slab_cache, slab_bench_objs[i]);
+	free_cycles = (uint32_t)(rdtsc() - start);
+	printf("slab: alloc %u cycles, free %u cycles (avg of %u, %u slabs at peak)\n",
+		alloc_cycles / SLAB_BENCH_OBJECTS, free_cycles / SLAB_BENCH_OBJECTS, SLAB_BENCH_OBJECTS,
+		(SLAB_BENCH_OBJECTS + bench_slab_cache.objs_per_slab - 1) / bench_slab_cache.objs_per_slab);
+
+	start = rdtsc();
+	for(i = 0; i < SLAB_BENCH_OBJECTS; i++)
+		if((slab_bench_objs[i] = (void*)frame_alloc()) == NULL)
+			return FAIL;
+	frame_cycles = (uint32_t)(rdtsc() - start);
+	start = rdtsc();
+	for(i = 0; i < SLAB_BENCH_OBJECTS; i++)
+		frame_put((uint32_t)slab_bench_objs[i]);
+	put_cycles = (uint32_t)(rdtsc() - start);
+	printf("frames: alloc %u cycles, put %u cycles (avg of %u)\n",
+		frame_cycles / SLAB_BENCH_OBJECTS, put_cycles / SLAB_BENCH_OBJECTS, SLAB_BENCH_OBJECTS);
+
+	return PASS;
+}
+
+#define PROCESS_TEST_COUNT 64
+
+static pcb_t* test_pcbs[PROCESS_TEST_COUNT];
+
+/*
+ * test_process_alloc
+ *    DESCRIPTION: Creates far more processes than the old fixed PCB layout had room for, then
+ *                 reaps them all
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUES: PASS if every process gets its own PID, PCB and kernel stack, lookups by PID
+ *                   work, a freed PID isn't handed out again right away, and everything is given
+ *                   back, FAIL otherwise
+ *    SIDE EFFECTS: Allocates and frees PCBs and kernel stacks
+ */
+int test_process_alloc(){
+	TEST_HEADER;
+	uint32_t i, live_before = process_stats.live;
+	uint32_t last_pid;
+	pcb_t *again;
+	int result = PASS;
+
+	for(i = 0; i < PROCESS_TEST_COUNT; i++){
+		test_pcbs[i] = process_alloc(-1);
+		if(test_pcbs[i] == NULL)
+			return FAIL;
+		if(test_pcbs[i]->process_id < MAX_TERMINALS || pid_to_pcb(test_pcbs[i]->process_id) != test_pcbs[i])
+			result = FAIL;
+		// The stack is the process's own and esp0 sits at its top
+		if(PCB_ESP0(test_pcbs[i]) != test_pcbs[i]->kernel_stack + KERNEL_STACK_SIZE - 4 ||
+		   (i > 0 && (test_pcbs[i]->process_id == test_pcbs[i - 1]->process_id ||
+		              test_pcbs[i]->kernel_stack == test_pcbs[i - 1]->kernel_stack)))
+			result = FAIL;
+	}
+	if(process_stats.live != live_before + PROCESS_TEST_COUNT)
+		result = FAIL;
+
+	// Base shell PIDs can't be taken a second time
+	if(process_alloc(0) != NULL)
+		result = FAIL;
+
+	last_pid = test_pcbs[PROCESS_TEST_COUNT - 1]->process_id;
+	for(i = 0; i < PROCESS_TEST_COUNT; i++)
+		process_free(test_pcbs[i]);
+	if(process_stats.live != live_before || pid_to_pcb(last_pid) != NULL)
+		result = FAIL;
+
+	again = process_alloc(-1);
+	if(again == NULL || again->process_id == last_pid)
+		result = FAIL;
+	if(again != NULL)
+		process_free(again);
+
+	return result;
+}
+
+#define BOOST_TEST_PCBS 4
+
+static pcb_t boost_test_pcbs[BOOST_TEST_PCBS];
+
+/*
+ * test_sched_boost
+ *    DESCRIPTION: Boosts the run queue with processes whose nice value is the level they're
+ *                 already queued at, next to ones that move up
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUES: PASS if the boost returns, every process ends up at its nice level with a
+ *                   fresh slice and is still queued exactly once, FAIL otherwise
+ *    SIDE EFFECTS: Runs with interrupts off and a made-up running process. Anything else on the
+ *                  run queue gets boosted too
+ */
+int test_sched_boost(){
+	TEST_HEADER;
+	static const uint32_t nice[BOOST_TEST_PCBS] = {1, 2, 0, MAX_NICE};
+	static const uint32_t level[BOOST_TEST_PCBS] = {MAX_NICE, 2, MAX_NICE, MAX_NICE};
+	pcb_t *saved_pcb;
+	uint32_t i, flags;
+	int result = PASS;
+
+	memset(boost_test_pcbs, 0, sizeof(boost_test_pcbs));
+	for(i = 0; i < BOOST_TEST_PCBS; i++){
+		boost_test_pcbs[i].nice = nice[i];
+		boost_test_pcbs[i].sched_level = level[i];
+	}
+
+	cli_and_save(flags);
+	saved_pcb = current_pcb;
+	current_pcb = &boost_test_pcbs[0];	// the running one isn't on the queue
+	for(i = 1; i < BOOST_TEST_PCBS; i++)
+		sched_add(&boost_test_pcbs[i]);
+
+	sched_boost_all();
+
+	for(i = 0; i < BOOST_TEST_PCBS; i++){
+		if(boost_test_pcbs[i].sched_level != nice[i] ||
+		   boost_test_pcbs[i].slice_left != SCHED_SLICE(nice[i]))
+			result = FAIL;
+	}
+	for(i = 1; i < BOOST_TEST_PCBS; i++){
+		if(sched_dequeue(&boost_test_pcbs[i]) != 0 || sched_dequeue(&boost_test_pcbs[i]) != -1)
+			result = FAIL;
+	}
+
+	current_pcb = saved_pcb;
+	restore_flags(flags);
+	return result;
+}
+
+#define PIPE_TEST_CHUNK 3000	// doesn't divide the pipe size, so the second write wraps the ring
+#define PIPE_TEST_FIRST_READ 2000	// leaves room for the second chunk, a full pipe would block
+
+static pcb_t test_pipe_pcb;
+static uint8_t pipe_test_in[2 * PIPE_TEST_CHUNK];
+static uint8_t pipe_test_out[2 * PIPE_TEST_CHUNK];
+
+/*
+ * test_pipe_ring
+ *    DESCRIPTION: Streams data through a pipe so that it wraps around the ring, then closes the
+ *                 write end and the read end
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUES: PASS if the bytes come out in order across the wrap, reads stop at what's
+ *                   there, the reader sees the end of the stream once the writer is gone, and the
+ *                   pipe is freed with its last end, FAIL otherwise
+ *    SIDE EFFECTS: Runs as a made-up process with interrupts off, so nothing ever blocks
+ */
+int test_pipe_ring(){
+	TEST_HEADER;
+	pcb_t *saved_pcb;
+	pipe_t *p;
+	uint32_t i, flags, live_before = pipe_stats.live;
+	int result = PASS;
+
+	for(i = 0; i < 2 * PIPE_TEST_CHUNK; i++)
+		pipe_test_in[i] = (uint8_t)(i * 7 + 3);
+
+	if((p = pipe_alloc()) == NULL)
+		return FAIL;
+
+	// fd 2 is the read end and fd 3 the write end, as the pipe syscall would hand them out
+	memset(&test_pipe_pcb, 0, sizeof(test_pipe_pcb));
+	test_pipe_pcb.fda[2].fops_table_ptr.read = pipe_read;
+	test_pipe_pcb.fda[2].fops_table_ptr.close = pipe_close;
+	test_pipe_pcb.fda[2].flags = 1;
+	test_pipe_pcb.fda[2].pipe = p;
+	test_pipe_pcb.fda[3].fops_table_ptr.write = pipe_write;
+	test_pipe_pcb.fda[3].fops_table_ptr.close = pipe_close;
+	test_pipe_pcb.fda[3].flags = 1;
+	test_pipe_pcb.fda[3].pipe = p;
+
+	cli_and_save(flags);
+	saved_pcb = current_pcb;
+	current_pcb = &test_pipe_pcb;
+
+	if(pipe_write(3, pipe_test_in, PIPE_TEST_CHUNK) != PIPE_TEST_CHUNK)
+		result = FAIL;
+	if(pipe_read(2, pipe_test_out, PIPE_TEST_FIRST_READ) != PIPE_TEST_FIRST_READ)
+		result = FAIL;
+	if(pipe_write(3, pipe_test_in + PIPE_TEST_CHUNK, PIPE_TEST_CHUNK) != PIPE_TEST_CHUNK)
+		result = FAIL;
+
+	// Asking for more than is there gets what is there
+	if(pipe_read(2, pipe_test_out + PIPE_TEST_FIRST_READ, 2 * PIPE_TEST_CHUNK) != 2 * PIPE_TEST_CHUNK - PIPE_TEST_FIRST_READ)
+		result = FAIL;
+	for(i = 0; i < 2 * PIPE_TEST_CHUNK; i++){
+		if(pipe_test_out[i] != pipe_test_in[i])
+			result = FAIL;
+	}
+
+	// With the writer gone, an empty pipe reads as the end of the stream instead of blocking
+	test_pipe_pcb.fda[3].flags = 0;
+	pipe_close(3);
+	if(pipe_read(2, pipe_test_out, 1) != 0 || pipe_stats.live != live_before + 1)
+		result = FAIL;
+	test_pipe_pcb.fda[2].flags = 0;
+	pipe_close(2);
+	if(pipe_stats.live != live_before)
+		result = FAIL;
+
+	current_pcb = saved_pcb;
+	restore_flags(flags);
+	return result;
+}
+
+/*
+ * test_mmap_file
+ *    DESCRIPTION: Maps a large file twice into pid 0's mmap area, then unmaps and maps it again
+ *    INPUTS: none
+ *    OUTPUTS: none
+ *    RETURN VALUES: PASS if mappings are placed first-fit, every page is accounted for, and
+ *                   munmap only accepts the start of a mapping
+ *    SIDE EFFECTS: Leaves pid 0's mmap area empty
+ */
+int test_mmap_file(){
+	TEST_HEADER;
+	dentry_t dentry;
+	uint32_t npages, pages_before, first, second, again;
+	int result = PASS;
+
+	if(read_dentry_by_name((uint8_t*)LARGE_TEXT_FNAME, &dentry) == -1)
+		return FAIL;
+	npages = (fs_inode[dentry.inode].file_size + FOUR_KB - 1) / FOUR_KB;
+	pages_before = mmap_stats.direct_pages + mmap_stats.copied_pages;
+
+	first = mmap_file(0, dentry.inode);
+	second = mmap_file(0, dentry.inode);
+	if(first != USER_MMAP_ADDR || second != first + npages * FOUR_KB)
+		result = FAIL;
+	if(mmap_stats.direct_pages + mmap_stats.copied_pages != pages_before + 2 * npages)
+		result = FAIL;
+
+	// Only the first page of a mapping can be unmapped
+	if(npages > 1 && munmap_pages(0, second + FOUR_KB) != -1)
+		result = FAIL;
+	if(munmap_pages(0, first) != 0 || munmap_pages(0, first) != -1)
+		result = FAIL;
+
+	// The hole it left is reused
+	again = mmap_file(0, dentry.inode);
+	if(again != first)
+		result = FAIL;
+
+	release_user_mmap_table(0);
+	return result;
+}
+
+/*
+ * tlb_flush_benchmark
+ *    DESCRIPTION: Compares the cost of invlpg against a full CR3 reload (including the misses the
+ *                 reload causes), then prints the flush counters for every syscall that flushed
+ *    INPUTS: none
+ *    OUTPUTS: prints average cycles per flush and the per-syscall flush table
+ *    RETURN VALUES: PASS if the counters moved by exactly the flushes made here, FAIL otherwise
+ *    SIDE EFFECTS: Flushes the TLB
+ */
+int tlb_flush_benchmark(){
+	TEST_HEADER;
+	uint32_t pages_before = tlb_stats.flushes[TLB_FLUSH_PAGE];
+	uint32_t alls_before = tlb_stats.flushes[TLB_FLUSH_ALL];
+	uint32_t page_cycles = 0, all_cycles = 0;
+	volatile uint8_t sink;
+	uint64_t start;
+	uint32_t i, j;
+
+	for(i = 0; i < BENCH_ITERATIONS; i++){
+		start = rdtsc();
+		tlb_flush_page(VIDMEM);
+		for(j = 0; j < BENCH_BUF_SIZE; j += FOUR_KB)		// touch pages that keep their translations
+			sink = bench_buf_new[j];
+		sink = *(uint8_t*)VIDMEM;
+		page_cycles += (uint32_t)(rdtsc() - start);
+
+		start = rdtsc();
+		tlb_flush_all();
+		for(j = 0; j < BENCH_BUF_SIZE; j += FOUR_KB)
+			sink = bench_buf_new[j];
+		sink = *(uint8_t*)VIDMEM;
+		all_cycles += (uint32_t)(rdtsc() - start);
+	}
+	(void)sink;
+	printf("invlpg + touch: %u cycles, CR3 reload + touch: %u cycles (avg of %u)\n",
+		page_cycles / BENCH_ITERATIONS, all_cycles / BENCH_ITERATIONS, BENCH_ITERATIONS);
+
+	printf("syscall: page all global switch\n");
+	for(i = 0; i < TLB_SYSCALL_SLOTS; i++){
+		if(tlb_stats.by_syscall[i][TLB_FLUSH_PAGE] + tlb_stats.by_syscall[i][TLB_FLUSH_ALL] +
+		   tlb_stats.by_syscall[i][TLB_FLUSH_GLOBAL] + tlb_stats.by_syscall[i][TLB_SWITCH] == 0)
+			continue;
+		printf("%u: %u %u %u %u\n", i, tlb_stats.by_syscall[i][TLB_FLUSH_PAGE], tlb_stats.by_syscall[i][TLB_FLUSH_ALL],
+			tlb_stats.by_syscall[i][TLB_FLUSH_GLOBAL], tlb_stats.by_syscall[i][TLB_SWITCH]);
+	}
+
+	if(tlb_stats.flushes[TLB_FLUSH_PAGE] - pages_before != BENCH_ITERATIONS ||
+	   tlb_stats.flushes[TLB_FLUSH_ALL] - alls_before != BENCH_ITERATIONS)
+		return FAIL;
+	return PASS;
+}
+
+/*
+ * scroll_bytewise
+ *    DESCRIPTION: The original one-line scroll, kept only as a benchmark baseline
+ *    INPUTS: screen -- text page to scroll
+ *    NOTES: Moves one char byte at a time and never moves the attribute bytes
+ */
+static void scroll_bytewise(char* screen){
+	int i, j;
+	for(i = 0; i < 25; i++){
+		for(j = 0; j < 80; j++){
+			if(i == 25 - 1)
+				*(uint8_t *)(screen + ((80 * i + j) << 1)) = ' ';
+			else
+				*(uint8_t *)(screen + ((80 * i + j) << 1)) = *(uint8_t *)(screen + ((80 * (i+1) + j) << 1));
+		}
+	}
+}
+
+/*
+ * console_throughput_benchmark
+ *    DESCRIPTION: Times one-line scrolls of VGA memory (old vs new) and then cats the large text
+ *                 file to the terminal, reporting characters per second
+ *    INPUTS: none
+ *    OUTPUTS: prints cycles per scroll, chars/sec and how many lines each scroll moved
+ *    RETURN VALUES: PASS if the file could be read and every write was consumed, FAIL otherwise
+ *    SIDE EFFECTS: Scrolls the screen and prints the file several times
+ */
+int console_throughput_benchmark(){
+	TEST_HEADER;
+	dentry_t dentry;
+	uint32_t size, i, cycles, cycles_per_char;
+	uint32_t old_cycles = 0, new_cycles = 0, chars = 0;
+	uint32_t scrolls_before, lines_before;
+	uint64_t start;
+	int result = PASS;
+
+	if(read_dentry_by_name((uint8_t*)LARGE_TEXT_FNAME, &dentry) == -1)
+		return FAIL;
+	size = read_data(dentry.inode, 0, bench_buf_new, BENCH_BUF_SIZE);
+
+	for(i = 0; i < BENCH_ITERATIONS; i++){
+		start = rdtsc();
+		scroll_bytewise((char*)VIDMEM);
+		old_cycles += (uint32_t)(rdtsc() - start);
+
+		start = rdtsc();
+		scroll((char*)VIDMEM, 1);
+		new_cycles += (uint32_t)(rdtsc() - start);
+	}
+
+	scrolls_before = console_stats.scrolls;
+	lines_before = console_stats.lines_scrolled;
+	start = rdtsc();
+	for(i = 0; i < BENCH_ITERATIONS / 4; i++){
+		if(terminal_write(1, bench_buf_new, size) != size)
+			result = FAIL;
+		chars += size;
+	}
+	cycles = (uint32_t)(rdtsc() - start);
+
+	printf("scroll: bytewise %u cycles, word-wide %u cycles (avg of %u)\n",
+		old_cycles / BENCH_ITERATIONS, new_cycles / BENCH_ITERATIONS, BENCH_ITERATIONS);
+	cycles_per_char = chars ? cycles / chars : 0;
+	if(cycles_per_char)		// tsc_khz * 10 / cycles_per_char is chars per 1/100 s, avoiding 64-bit division
+		printf("cat: %u chars, %u cycles/char, ~%u chars/sec\n", chars, cycles_per_char,
+			(tsc_khz * 10 / cycles_per_char) * 100);
+	if(console_stats.scrolls != scrolls_before)
+		printf("cat: %u lines scrolled in %u scrolls\n", console_stats.lines_scrolled - lines_before,
+			console_stats.scrolls - scrolls_before);
+
+	return result;
+}
+
+
 /* Test suite entry point */
 void launch_tests(){
 	TEST_OUTPUT("idt_test", idt_test());							// Checks descriptor offset field for NULL
@@ -284,6 +1089,19 @@ void launch_tests(){
 	//TEST_OUTPUT("test_RTC_read", test_RTC_read());
 	//TEST_OUTPUT("test_RTC_write", test_RTC_write());
 	//TEST_OUTPUT("test_terminal_keyboard", test_terminal_keyboard());
+	//TEST_OUTPUT("test_keyboard_ring", test_keyboard_ring());
+	//TEST_OUTPUT("test_keyboard_translate", test_keyboard_translate());
 	//TEST_OUTPUT("list_all_files", list_all_files());
 	//TEST_OUTPUT("read_file_by_name", read_file_by_name());
+	//TEST_OUTPUT("read_data_benchmark", read_data_benchmark());
+	//TEST_OUTPUT("dentry_lookup_benchmark", dentry_lookup_benchmark());
+	//TEST_OUTPUT("test_frame_refcounts", test_frame_refcounts());
+	//TEST_OUTPUT("test_slab_cache", test_slab_cache());
+	//TEST_OUTPUT("slab_alloc_benchmark", slab_alloc_benchmark());
+	//TEST_OUTPUT("test_process_alloc", test_process_alloc());
+	//TEST_OUTPUT("test_sched_boost", test_sched_boost());
+	//TEST_OUTPUT("test_pipe_ring", test_pipe_ring());
+	//TEST_OUTPUT("test_mmap_file", test_mmap_file());
+	//TEST_OUTPUT("tlb_flush_benchmark", tlb_flush_benchmark());
+	//TEST_OUTPUT("console_throughput_benchmark", console_throughput_benchmark());
 }
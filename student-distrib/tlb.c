@@ -0,0 +1,92 @@
+/* tlb.c - TLB maintenance with per-type and per-syscall flush counters
+ * vim:ts=4 noexpandtab
+ */
+
+/* With CR4.PGE set, entries for pages marked global (the kernel) survive CR3 loads, so
+ * switching address spaces only costs the user translations. Single-entry remaps use invlpg
+ * and a full flush is left for when a whole address space changes.
+ * (https://wiki.osdev.org/TLB)
+ */
+
+#include "tlb.h"
+#include "system_calls.h"
+
+#define CR4_PGE 0x00000080
+
+/*
+ * count_flush
+ *    DESCRIPTION: Bumps the counters for one flush of the given type
+ *    INPUTS: type -- one of the TLB_* flush types
+ *    RETURNS: none
+ */
+static void count_flush(uint32_t type) {
+    uint32_t slot = current_syscall < TLB_SYSCALL_SLOTS ? current_syscall : 0;
+    tlb_stats.flushes[type]++;
+    tlb_stats.by_syscall[slot][type]++;
+}
+
+/*
+ * tlb_flush_page
+ *    DESCRIPTION: Invalidates the TLB entry (and any cached directory entry) for one address
+ *    INPUTS: addr -- linear address whose mapping changed
+ *    RETURNS: none
+ */
+void tlb_flush_page(uint32_t addr) {
+    asm volatile ("invlpg (%0)"
+                :               // no outputs
+                : "r" (addr)
+                : "memory"
+    );
+    count_flush(TLB_FLUSH_PAGE);
+}
+
+/*
+ * tlb_flush_all
+ *    DESCRIPTION: Invalidates every non-global TLB entry
+ *    INPUTS/OUTPUTS: none
+ *    SIDE EFFECTS: Reloads CR3 with its current value
+ */
+void tlb_flush_all(void) {
+    asm volatile ("movl	%%cr3, %%eax;"
+	              "movl	%%eax, %%cr3;"
+                :               // no outputs
+                :               // no inputs
+                : "eax", "memory"
+    );
+    count_flush(TLB_FLUSH_ALL);
+}
+
+/*
+ * tlb_flush_global
+ *    DESCRIPTION: Invalidates every TLB entry, global ones included
+ *    INPUTS/OUTPUTS: none
+ *    SIDE EFFECTS: Clears and restores CR4.PGE (does nothing extra if PGE was never set)
+ */
+void tlb_flush_global(void) {
+    asm volatile ("movl %%cr4, %%eax;"
+                  "movl %%eax, %%edx;"
+                  "andl %0, %%eax;"
+                  "movl %%eax, %%cr4;"          // clearing PGE flushes everything
+                  "movl %%edx, %%cr4;"
+                :               // no outputs
+                : "i" (~CR4_PGE)
+                : "eax", "edx", "memory"
+    );
+    count_flush(TLB_FLUSH_GLOBAL);
+}
+
+/*
+ * tlb_switch_directory
+ *    DESCRIPTION: Loads a page directory into CR3
+ *    INPUTS: page_dir -- 4KB aligned page directory
+ *    RETURNS: none
+ *    SIDE EFFECTS: Non-global TLB entries of the old address space are dropped
+ */
+void tlb_switch_directory(void* page_dir) {
+    asm volatile ("movl %0, %%cr3;"
+                :               // no outputs
+                : "r" (page_dir)
+                : "memory"
+    );
+    count_flush(TLB_SWITCH);
+}
@@ -0,0 +1,39 @@
+/* tlb.h - TLB maintenance with per-type and per-syscall flush counters
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _TLB_H
+#define _TLB_H
+
+#include "types.h"
+
+// Kinds of TLB invalidation, used to index the flush counters
+#define TLB_FLUSH_PAGE 0        // invlpg of one linear address
+#define TLB_FLUSH_ALL 1         // CR3 reload, drops every non-global entry
+#define TLB_FLUSH_GLOBAL 2      // CR4.PGE toggle, drops global entries too
+#define TLB_SWITCH 3            // CR3 load of a different page directory
+#define TLB_FLUSH_TYPES 4
+
+// Flushes are attributed to the syscall in progress, slot 0 is "not in a syscall"
+#define TLB_SYSCALL_SLOTS 32
+
+typedef struct tlb_stats {
+    uint32_t flushes[TLB_FLUSH_TYPES];                          // totals by type
+    uint32_t by_syscall[TLB_SYSCALL_SLOTS][TLB_FLUSH_TYPES];    // totals by syscall number and type
+} tlb_stats_t;
+
+tlb_stats_t tlb_stats;
+
+// Invalidates the translation for one linear address (global or not)
+extern void tlb_flush_page(uint32_t addr);
+
+// Invalidates every non-global translation by reloading CR3
+extern void tlb_flush_all(void);
+
+// Invalidates every translation including global ones (for changes to kernel mappings)
+extern void tlb_flush_global(void);
+
+// Loads a new page directory
+extern void tlb_switch_directory(void* page_dir);
+
+#endif /* _TLB_H */
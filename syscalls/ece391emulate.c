@@ -213,6 +213,80 @@ ece391_write (int32_t fd, const void* buf, int32_t nbytes)
     return -1;
 }
 
+int32_t 
+ece391_readv (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt)
+{
+    int32_t i, cnt, total = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (0 > (cnt = ece391_read (fd, iov[i].base, iov[i].len)))
+	    return (0 == total ? -1 : total);
+	total += cnt;
+	if (cnt < iov[i].len)
+	    break;
+    }
+    return total;
+}
+
+int32_t 
+ece391_writev (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt)
+{
+    int32_t i, cnt, total = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (0 > (cnt = ece391_write (fd, iov[i].base, iov[i].len)))
+	    return (0 == total ? -1 : total);
+	total += cnt;
+	if (cnt < iov[i].len)
+	    break;
+    }
+    return total;
+}
+
+#define EMULATE_MAX_MAPS 8
+static void* map_addr[EMULATE_MAX_MAPS];
+static size_t map_len[EMULATE_MAX_MAPS];
+
+int32_t 
+ece391_mmap (int32_t fd, void** addr)
+{
+    off_t pos, size;
+    int32_t i;
+
+    if ((NULL != dir && dir_fd == fd) ||
+        -1 == (pos = lseek (fd, 0, SEEK_CUR)) ||
+	-1 == (size = lseek (fd, 0, SEEK_END)) ||
+	-1 == lseek (fd, pos, SEEK_SET))
+        return -1;
+    if (0 == size) {
+        *addr = NULL;
+	return 0;
+    }
+    for (i = 0; EMULATE_MAX_MAPS > i && NULL != map_addr[i]; i++);
+    if (EMULATE_MAX_MAPS == i)
+        return -1;
+    if (MAP_FAILED == (*addr = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0)))
+        return -1;
+    map_addr[i] = *addr;
+    map_len[i] = size;
+    return size;
+}
+
+int32_t 
+ece391_munmap (void* addr)
+{
+    int32_t i;
+
+    for (i = 0; EMULATE_MAX_MAPS > i; i++) {
+        if (NULL != addr && map_addr[i] == addr) {
+	    (void)munmap (addr, map_len[i]);
+	    map_addr[i] = NULL;
+	    return 0;
+	}
+    }
+    return -1;
+}
+
 int32_t 
 ece391_close (int32_t fd)
 {
@@ -0,0 +1,105 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Cycles to start and reap a process three ways: fork a child that halts
+ * right away and wait for it, fork a child that execs a trivial program,
+ * and execute that trivial program. The trivial program is this one run as
+ * "forkbench nop", which returns as soon as it starts. fork shares the
+ * parent's pages instead of loading anything, so the first number should
+ * be well below the other two. Prints the fastest and the average round.
+ */
+
+#define FORK_ROUNDS 200
+#define NOP_COMMAND "forkbench nop"
+
+typedef int32_t (*round_fn) (void);
+
+static uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+/* fork, the child halts, the parent waits for it */
+static int32_t fork_exit (void)
+{
+    int32_t pid, status;
+
+    if (-1 == (pid = ece391_fork ()))
+        return -1;
+    if (0 == pid)
+        ece391_halt (0);
+    if (pid != ece391_wait (&status) || status != 0)
+        return -1;
+    return 0;
+}
+
+/* fork, the child runs the trivial program in its place, the parent waits for it */
+static int32_t fork_exec (void)
+{
+    int32_t pid, status;
+
+    if (-1 == (pid = ece391_fork ()))
+        return -1;
+    if (0 == pid) {
+        ece391_exec ((uint8_t*)NOP_COMMAND);
+        ece391_halt (1);
+    }
+    if (pid != ece391_wait (&status) || status != 0)
+        return -1;
+    return 0;
+}
+
+/* execute the trivial program, which blocks until it halts */
+static int32_t execute_nop (void)
+{
+    return (0 == ece391_execute ((uint8_t*)NOP_COMMAND)) ? 0 : -1;
+}
+
+static int32_t measure (const char* label, round_fn run)
+{
+    uint8_t buf[16];
+    uint32_t i, start, cycles, total = 0, best = 0xFFFFFFFF;
+
+    /* Warm up the caches and pull the program into the image cache */
+    if (-1 == run ())
+        return -1;
+
+    for (i = 0; i < FORK_ROUNDS; i++) {
+        start = rdtsc_lo ();
+        if (-1 == run ())
+            return -1;
+        cycles = rdtsc_lo () - start;
+        total += cycles;
+        if (cycles < best)
+            best = cycles;
+    }
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, (uint8_t*)"min ");
+    ece391_fdputs (1, ece391_itoa (best, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles, avg ");
+    ece391_fdputs (1, ece391_itoa (total / FORK_ROUNDS, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles\n");
+    return 0;
+}
+
+int main ()
+{
+    uint8_t args[128];
+
+    if (0 == ece391_getargs (args, sizeof (args)))
+        return (0 == ece391_strcmp (args, (uint8_t*)"nop")) ? 0 : 3;
+
+    if (-1 == measure ("fork+exit:    ", fork_exit) ||
+        -1 == measure ("fork+exec:    ", fork_exec) ||
+        -1 == measure ("execute:      ", execute_nop)) {
+        ece391_fdputs (1, (uint8_t*)"forkbench: a round failed\n");
+        return 2;
+    }
+    return 0;
+}
@@ -6,19 +6,67 @@
 #define BUFSIZE 1024
 #define SBUFSIZE 33
 
-int32_t
-do_one_file (const char* s, const char* fname) 
+/*
+ * "grep PATTERN" searches every file in the directory. "grep PATTERN -"
+ * searches standard input instead, for the end of a pipeline such as
+ * "cat frame0.txt | grep fish -".
+ */
+
+/*
+ * Searches a file mapped with mmap, printing straight from the mapping.
+ * A matching line is printed up to its first NUL, like the read path
+ * that prints it as a string, so binaries don't dump raw bytes.
+ */
+static void
+grep_mapped (const char* s, const char* fname, const uint8_t* data, int32_t size)
 {
-    int32_t fd, cnt, last, line_start, line_end, check, s_len;
-    uint8_t data[BUFSIZE+1];
+    int32_t line_start, line_end, check, s_len, len;
+    struct ece391_iovec match[4];   /* "fname:line\n", printed with one writev */
 
+    match[0].base = (void*)fname;
+    match[0].len = ece391_strlen ((uint8_t*)fname);
+    match[1].base = ":";
+    match[1].len = 1;
+    match[3].base = "\n";
+    match[3].len = 1;
     s_len = ece391_strlen ((uint8_t*)s);
-    if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
-        ece391_fdputs (1, (uint8_t*)"file open failed\n");
-        return -1;
+
+    for (line_start = 0; line_start < size; line_start = line_end + 1) {
+	line_end = line_start;
+	while (line_end < size && '\n' != data[line_end])
+	    line_end++;
+	for (check = line_start; check + s_len <= line_end; check++) {
+	    if (s[0] == data[check] &&
+		0 == ece391_strncmp (data + check, (uint8_t*)s, s_len)) {
+		for (len = 0; line_start + len < line_end &&
+		     '\0' != data[line_start + len]; len++)
+		    ;
+		match[2].base = (void*)(data + line_start);
+		match[2].len = len;
+		(void)ece391_writev (1, match, 4);
+		break;
+	    }
+	}
     }
+}
+
+/*
+ * Searches what fd reads in chunks, until a read returns 0. Matches are
+ * labelled with fname, or printed bare if fname is 0.
+ */
+static int32_t
+grep_stream (const char* s, const char* fname, int32_t fd)
+{
+    int32_t cnt = 1, last, line_start, line_end, check, s_len;
+    uint8_t data[BUFSIZE+1];
+    const uint8_t* match[4];    /* "fname:line\n", printed with one writev */
+
+    match[1] = (uint8_t*)":";
+    match[3] = (uint8_t*)"\n";
+    s_len = ece391_strlen ((uint8_t*)s);
+
     last = 0;
-    while (1) {
+    while (0 != cnt) {
         cnt = ece391_read (fd, data + last, BUFSIZE - last);
 	if (-1 == cnt) {
             ece391_fdputs (1, (uint8_t*)"file read failed\n");
@@ -30,11 +78,18 @@ do_one_file (const char* s, const char* fname)
 	    line_end = line_start;
 	    while (line_end < last && '\n' != data[line_end])
 		line_end++;
-	    if ('\n' != data[line_end] && 0 != cnt && line_start != 0) {
+	    /*
+	     * A line with no '\n' yet may go on in the next read (pipes
+	     * return short reads), so keep it unless it fills the buffer
+	     */
+	    if ('\n' != data[line_end] && 0 != cnt &&
+		(0 != line_start || last < BUFSIZE)) {
 		/* copy from line_start to last down to 0 and fix last */
-		data[line_end] = '\0';
-		ece391_strcpy (data, data + line_start);
-		last -= line_start;
+		if (0 != line_start) {
+		    data[line_end] = '\0';
+		    ece391_strcpy (data, data + line_start);
+		    last -= line_start;
+		}
 		break;
 	    }
 	    /* search the line */
@@ -42,10 +97,12 @@ do_one_file (const char* s, const char* fname)
 	    for (check = line_start; check < line_end; check++) {
 		if (s[0] == data[check] && 
 		    0 == ece391_strncmp ((uint8_t*)(data + check), (uint8_t*)s, s_len)) {
-		    ece391_fdputs (1, (uint8_t*)fname);
-		    ece391_fdputs (1, (uint8_t*)":");
-		    ece391_fdputs (1, data + line_start);
-		    ece391_fdputs (1, (uint8_t*)"\n");
+		    match[0] = (uint8_t*)fname;
+		    match[2] = data + line_start;
+		    if (0 == fname)
+			ece391_fdputsv (1, match + 2, 2);
+		    else
+			ece391_fdputsv (1, match, 4);
 		    break;
 		}
 	    }
@@ -58,6 +115,28 @@ do_one_file (const char* s, const char* fname)
 	if (0 == cnt)
 	    break;
     }
+    return 0;
+}
+
+int32_t
+do_one_file (const char* s, const char* fname) 
+{
+    int32_t fd, cnt;
+    void* mapped;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
+        ece391_fdputs (1, (uint8_t*)"file open failed\n");
+        return -1;
+    }
+
+    /* Regular files can be searched in place, anything else is read in chunks */
+    if (-1 != (cnt = ece391_mmap (fd, &mapped))) {
+        grep_mapped (s, fname, mapped, cnt);
+	if (0 != cnt)
+	    (void)ece391_munmap (mapped);
+    }
+    else if (-1 == grep_stream (s, fname, fd))
+        return -1;
     if (-1 == ece391_close (fd)) {
         ece391_fdputs (1, (uint8_t*)"file close failed\n");
         return -1;
@@ -67,7 +146,7 @@ do_one_file (const char* s, const char* fname)
 
 int main ()
 {
-    int32_t fd, cnt;
+    int32_t fd, cnt, len;
     uint8_t buf[SBUFSIZE];
     uint8_t search[BUFSIZE];
 
@@ -76,6 +155,12 @@ int main ()
         return 3;
     }
 
+    len = ece391_strlen (search);
+    if (len > 2 && ' ' == search[len - 2] && '-' == search[len - 1]) {
+        search[len - 2] = '\0';
+	return (0 == grep_stream ((char*)search, 0, 0)) ? 0 : 3;
+    }
+
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
 	return 2;
@@ -0,0 +1,60 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Runs a fixed amount of CPU work and reports how many TSC cycles of wall-clock time it took.
+ * Run it in one terminal while the other terminals sit at a shell prompt (or run counter/pingpong
+ * there): if blocked processes still burned their time slices, the wall-clock time grows with
+ * the number of waiting terminals; with wait queues it stays close to the single-terminal time.
+ * "loadbench N" runs at nice N first, to check that typing in the other terminals stays snappy
+ * while it (and anything else at a lower priority) saturates the CPU.
+ */
+
+#define WORK_ROUNDS 20
+#define ROUND_ITERS 5000000
+
+static uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+int main ()
+{
+    uint8_t buf[16];
+    uint8_t args[128];
+    volatile uint32_t acc = 1;
+    uint32_t round, i, start, cycles, total_mcycles = 0;
+
+    if (0 == ece391_getargs (args, sizeof (args))) {
+        if (args[0] < '0' || args[0] > '9' || args[1] != '\0' ||
+            -1 == ece391_nice (args[0] - '0')) {
+            ece391_fdputs (1, (uint8_t*)"usage: loadbench [nice]\n");
+            return 3;
+        }
+    }
+
+    for (round = 0; round < WORK_ROUNDS; round++) {
+        start = rdtsc_lo ();
+        for (i = 0; i < ROUND_ITERS; i++)
+            acc = acc * 1664525 + 1013904223;
+        cycles = rdtsc_lo () - start;
+        total_mcycles += cycles >> 20;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"loadbench: ");
+    ece391_itoa (total_mcycles, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)" Mcycles wall-clock for ");
+    ece391_itoa (WORK_ROUNDS, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)" rounds (");
+    ece391_itoa (total_mcycles / WORK_ROUNDS, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)" per round)\n");
+
+    return 0;
+}
@@ -4,24 +4,35 @@
 #include "ece391syscall.h"
 
 #define SBUFSIZE 33
+#define LS_BATCH 8      /* entries per readv, printed with their newlines by one writev */
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, cnt, i, n;
+    uint8_t names[LS_BATCH][SBUFSIZE-1];
+    struct ece391_iovec in[LS_BATCH];
+    struct ece391_iovec out[2 * LS_BATCH];
 
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
         return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    for (i = 0; i < LS_BATCH; i++) {
+        in[i].base = out[2 * i].base = names[i];
+        in[i].len = out[2 * i].len = SBUFSIZE-1;
+        out[2 * i + 1].base = "\n";
+        out[2 * i + 1].len = 1;
+    }
+
+    /* Each directory read fills one name, readv stops at the end of the directory */
+    while (0 != (cnt = ece391_readv (fd, in, LS_BATCH))) {
         if (-1 == cnt) {
 	        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	        return 3;
 	    }
-	    buf[cnt] = '\n';
-	    if (-1 == ece391_write (1, buf, cnt + 1))
+	    n = cnt / (SBUFSIZE-1);
+	    if (-1 == ece391_writev (1, out, 2 * n))
 	        return 3;
     }
 
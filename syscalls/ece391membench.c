@@ -0,0 +1,62 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define COMPUTE_ITERS 1000000
+#define SWEEP_BYTES (256 * 1024)
+#define SWEEP_PASSES 8
+#define CACHE_LINE 64
+
+static uint8_t sweep_buf[SWEEP_BYTES];
+
+static uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+static void print_result (const char* label, uint32_t cycles, uint32_t per, const char* unit)
+{
+    uint8_t buf[16];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_itoa (cycles, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)" cycles (");
+    ece391_itoa (cycles / per, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)unit);
+}
+
+int main ()
+{
+    volatile uint32_t acc = 1;      /* volatile keeps the loop on the stack */
+    uint32_t i, pass, sum, start, cycles;
+
+    /* Tight compute loop: instruction fetch plus a stack load/store every iteration */
+    start = rdtsc_lo ();
+    for (i = 0; i < COMPUTE_ITERS; i++)
+        acc = acc * 1664525 + 1013904223;
+    cycles = rdtsc_lo () - start;
+    print_result ("compute: ", cycles, COMPUTE_ITERS / 1000, " per 1000 iterations)\n");
+
+    /* Touch every page once so demand paging isn't part of the sweep */
+    for (i = 0; i < SWEEP_BYTES; i += 4096)
+        sweep_buf[i] = 0;
+
+    /* Memory sweep: write then read back every byte, one cache line at a time */
+    sum = 0;
+    start = rdtsc_lo ();
+    for (pass = 0; pass < SWEEP_PASSES; pass++) {
+        for (i = 0; i < SWEEP_BYTES; i += 4)
+            *(uint32_t*)(sweep_buf + i) = i + pass;
+        for (i = 0; i < SWEEP_BYTES; i += CACHE_LINE)
+            sum += sweep_buf[i];
+    }
+    cycles = rdtsc_lo () - start;
+    print_result ("sweep:   ", cycles, SWEEP_PASSES * (SWEEP_BYTES / 1024), " per KB)\n");
+
+    return (sum == 0xFFFFFFFF);     /* use sum so the reads stay */
+}
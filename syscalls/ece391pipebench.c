@@ -0,0 +1,120 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Pipe throughput and latency between two processes. Throughput: a forked
+ * child writes THROUGHPUT_BYTES into a pipe in WRITE_SIZE chunks while the
+ * parent reads it all back, printed as cycles per KB. Latency: the parent
+ * and child bounce one byte back and forth over two pipes, so every round
+ * trip is two wakeups and two process switches, printed as the fastest and
+ * average round trip.
+ */
+
+#define WRITE_SIZE 4096
+#define THROUGHPUT_BYTES (4 * 1024 * 1024)
+#define PINGPONG_ROUNDS 2000
+
+static uint8_t chunk[WRITE_SIZE];
+
+static uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+static void print_num (const char* label, uint32_t value, const char* unit)
+{
+    uint8_t buf[16];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, ece391_itoa (value, buf, 10));
+    ece391_fdputs (1, (uint8_t*)unit);
+}
+
+static int32_t throughput (void)
+{
+    int32_t fds[2], pid, cnt, status;
+    uint32_t total = 0, start, cycles;
+
+    if (-1 == ece391_pipe (fds))
+        return -1;
+    if (-1 == (pid = ece391_fork ()))
+        return -1;
+
+    if (0 == pid) {
+        ece391_close (fds[0]);
+        for (total = 0; total < THROUGHPUT_BYTES; total += WRITE_SIZE) {
+            if (WRITE_SIZE != ece391_write (fds[1], chunk, WRITE_SIZE))
+                ece391_halt (1);
+        }
+        ece391_halt (0);
+    }
+
+    ece391_close (fds[1]);
+    start = rdtsc_lo ();
+    while (0 < (cnt = ece391_read (fds[0], chunk, WRITE_SIZE)))
+        total += cnt;
+    cycles = rdtsc_lo () - start;
+    ece391_close (fds[0]);
+
+    if (pid != ece391_wait (&status) || 0 != status || THROUGHPUT_BYTES != total)
+        return -1;
+    print_num ("throughput: ", cycles / (THROUGHPUT_BYTES / 1024), " cycles/KB over ");
+    print_num ("", THROUGHPUT_BYTES / 1024, " KB\n");
+    return 0;
+}
+
+static int32_t pingpong (void)
+{
+    int32_t ping[2], pong[2], pid, status;
+    uint32_t i, start, cycles, total = 0, best = 0xFFFFFFFF;
+    uint8_t c = 'x';
+
+    if (-1 == ece391_pipe (ping) || -1 == ece391_pipe (pong))
+        return -1;
+    if (-1 == (pid = ece391_fork ()))
+        return -1;
+
+    /* The child echoes every byte until the parent closes its end */
+    if (0 == pid) {
+        ece391_close (ping[1]);
+        ece391_close (pong[0]);
+        while (1 == ece391_read (ping[0], &c, 1)) {
+            if (1 != ece391_write (pong[1], &c, 1))
+                ece391_halt (1);
+        }
+        ece391_halt (0);
+    }
+
+    ece391_close (ping[0]);
+    ece391_close (pong[1]);
+    for (i = 0; i < PINGPONG_ROUNDS; i++) {
+        start = rdtsc_lo ();
+        if (1 != ece391_write (ping[1], &c, 1) || 1 != ece391_read (pong[0], &c, 1))
+            return -1;
+        cycles = rdtsc_lo () - start;
+        total += cycles;
+        if (cycles < best)
+            best = cycles;
+    }
+    ece391_close (ping[1]);
+    ece391_close (pong[0]);
+
+    if (pid != ece391_wait (&status) || 0 != status)
+        return -1;
+    print_num ("ping-pong:  min ", best, " cycles, ");
+    print_num ("avg ", total / PINGPONG_ROUNDS, " cycles per round trip\n");
+    return 0;
+}
+
+int main ()
+{
+    if (-1 == throughput () || -1 == pingpong ()) {
+        ece391_fdputs (1, (uint8_t*)"pipebench: a benchmark failed\n");
+        return 2;
+    }
+    return 0;
+}
@@ -4,6 +4,91 @@
 #include "ece391syscall.h"
 
 #define BUFSIZE 1024
+#define MAX_STAGES 8            /* most commands in one pipeline */
+#define STATUS_NO_COMMAND 127   /* how a pipeline stage halts if exec fails */
+
+/*
+ * Runs "cmd1 | cmd2 | ...". Each command runs in a forked copy of the shell
+ * that moves the pipe from the previous command onto its stdin and the pipe
+ * to the next one onto its stdout, then execs the command, so they all run
+ * at once. Returns what the last command returned, or -1 if a command
+ * doesn't exist, as execute does. Returns -2 if the pipeline is malformed.
+ */
+static int32_t run_pipeline (uint8_t* buf)
+{
+    uint8_t* stages[MAX_STAGES];
+    uint8_t* p;
+    int32_t nstages = 1, started = 0, in_fd = -1, fds[2];
+    int32_t i, pid, last_pid = -1, status, rval = 0;
+
+    /* Split at each '|' and trim the spaces around every command */
+    stages[0] = buf;
+    for (p = buf; '\0' != *p; p++) {
+        if ('|' != *p)
+            continue;
+        if (MAX_STAGES == nstages)
+            return -2;
+        *p = '\0';
+        stages[nstages++] = p + 1;
+    }
+    for (i = 0; i < nstages; i++) {
+        while (' ' == *stages[i])
+            stages[i]++;
+        p = stages[i] + ece391_strlen (stages[i]);
+        while (p > stages[i] && ' ' == p[-1])
+            *--p = '\0';
+        if ('\0' == *stages[i])
+            return -2;
+    }
+
+    for (i = 0; i < nstages; i++) {
+        fds[0] = fds[1] = -1;
+        if (i + 1 < nstages && -1 == ece391_pipe (fds))
+            break;
+        if (-1 == (pid = ece391_fork ())) {
+            if (-1 != fds[0]) {
+                ece391_close (fds[0]);
+                ece391_close (fds[1]);
+            }
+            break;
+        }
+        if (0 == pid) {
+            if (-1 != in_fd) {
+                ece391_dup2 (in_fd, 0);
+                ece391_close (in_fd);
+            }
+            if (-1 != fds[1]) {
+                ece391_dup2 (fds[1], 1);
+                ece391_close (fds[0]);
+                ece391_close (fds[1]);
+            }
+            ece391_exec (stages[i]);
+            ece391_halt (STATUS_NO_COMMAND);
+        }
+
+        /* The children hold the ends now, the shell keeps only the next read end */
+        started++;
+        last_pid = pid;
+        if (-1 != in_fd)
+            ece391_close (in_fd);
+        if (-1 != fds[1])
+            ece391_close (fds[1]);
+        in_fd = fds[0];
+    }
+    if (-1 != in_fd)
+        ece391_close (in_fd);       /* only if a pipe or fork failed partway */
+
+    while (started-- > 0) {
+        pid = ece391_wait (&status);
+        if (STATUS_NO_COMMAND == status)
+            rval = -1;
+        else if (pid == last_pid && -1 != rval)
+            rval = status;
+    }
+    if (i < nstages)
+        ece391_fdputs (1, (uint8_t*)"could not start the whole pipeline\n");
+    return rval;
+}
 
 int main ()
 {
@@ -24,8 +109,14 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
-	rval = ece391_execute (buf);
-	if (-1 == rval)
+	for (cnt = 0; '\0' != buf[cnt] && '|' != buf[cnt]; cnt++);
+	if ('|' == buf[cnt])
+	    rval = run_pipeline (buf);
+	else
+	    rval = ece391_execute (buf);
+	if (-2 == rval)
+	    ece391_fdputs (1, (uint8_t*)"bad pipeline\n");
+	else if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
 	else if (256 == rval)
 	    ece391_fdputs (1, (uint8_t*)"program terminated by exception\n");
@@ -21,6 +21,23 @@ void ece391_fdputs(int32_t fd, const uint8_t* s)
     (void)ece391_write (fd, s, ece391_strlen(s));
 }
 
+/* Writes n strings back to back with one writev per ECE391_IOV_MAX of them */
+void ece391_fdputsv(int32_t fd, const uint8_t* const* strs, uint32_t n)
+{
+    struct ece391_iovec iov[ECE391_IOV_MAX];
+    uint32_t cnt;
+
+    while (n > 0) {
+        for (cnt = 0; cnt < n && cnt < ECE391_IOV_MAX; cnt++) {
+            iov[cnt].base = (void*)strs[cnt];
+            iov[cnt].len = ece391_strlen(strs[cnt]);
+        }
+        (void)ece391_writev (fd, iov, cnt);
+        strs += cnt;
+        n -= cnt;
+    }
+}
+
 int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2)
 {
     while (*s1 == *s2) {
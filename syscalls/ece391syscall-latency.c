@@ -0,0 +1,60 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Round-trip cycles of a syscall that does no work, through INT $0x80 and
+ * through sysenter. There is no null syscall, so this closes fd -1, which the
+ * kernel turns down right after dispatch. Prints the fastest and the average
+ * round trip for each path.
+ */
+
+#define LATENCY_ITERS 10000
+#define NULL_FD -1
+
+typedef int32_t (*close_fn) (int32_t fd);
+
+static uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+static void measure (const char* label, close_fn call)
+{
+    uint8_t buf[16];
+    uint32_t i, start, cycles, total = 0, best = 0xFFFFFFFF;
+
+    /* Warm up the caches and TLB so the first call isn't counted */
+    call (NULL_FD);
+
+    for (i = 0; i < LATENCY_ITERS; i++) {
+        start = rdtsc_lo ();
+        call (NULL_FD);
+        cycles = rdtsc_lo () - start;
+        total += cycles;
+        if (cycles < best)
+            best = cycles;
+    }
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, (uint8_t*)"min ");
+    ece391_fdputs (1, ece391_itoa (best, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles, avg ");
+    ece391_fdputs (1, ece391_itoa (total / LATENCY_ITERS, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles\n");
+}
+
+int main ()
+{
+    if (ece391_fast_close (NULL_FD) != -1) {
+        ece391_fdputs (1, (uint8_t*)"syscall-latency: sysenter path returned the wrong value\n");
+        return 2;
+    }
+
+    measure ("int $0x80: ", ece391_close);
+    measure ("sysenter:  ", ece391_fast_close);
+    return 0;
+}
@@ -5,6 +5,13 @@
 
 /* All calls return >= 0 on success or -1 on failure. */
 
+/* One buffer for readv and writev, which take up to IOV_MAX of them. */
+#define ECE391_IOV_MAX 16
+struct ece391_iovec {
+	void* base;
+	int32_t len;
+};
+
 /*  
  * Note that the system call for halt will have to make sure that only
  * the low byte of EBX (the status argument) is returned to the calling
@@ -21,6 +28,65 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_nice (int32_t value);
+
+/*
+ * Read into or write out several buffers with one call, in order. Both
+ * return the total bytes moved. readv stops after a short read.
+ */
+extern int32_t ece391_readv (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt);
+extern int32_t ece391_writev (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt);
+
+/*
+ * Map an open regular file read-only, without copying it. mmap returns
+ * the file's size and puts the address of its first byte in *addr (NULL
+ * for an empty file). Writing to the mapping ends the program. munmap
+ * takes the address mmap gave back.
+ */
+extern int32_t ece391_mmap (int32_t fd, void** addr);
+extern int32_t ece391_munmap (void* addr);
+
+/*
+ * fork makes a copy of the calling program that runs alongside it. It
+ * returns the child's PID to the parent and 0 to the child. Memory is
+ * shared until one of them writes to it, open files are copied. exec
+ * replaces the calling program with another one in the same process, and
+ * only returns (-1) if that isn't an executable. wait sleeps until a forked
+ * child halts, puts its status in *status (if not NULL) and returns its
+ * PID, or returns -1 if there are no forked children left.
+ */
+extern int32_t ece391_fork (void);
+extern int32_t ece391_exec (const uint8_t* command);
+extern int32_t ece391_wait (int32_t* status);
+
+/*
+ * pipe opens both ends of a new pipe, the read end in fds[0] and the write
+ * end in fds[1]. A read waits until there is data and returns 0 once the
+ * pipe is empty and every write end is closed. A write waits for room until
+ * all of it is in. dup2 makes newfd (stdin and stdout included) refer to
+ * what oldfd does, closing whatever newfd had open. Pipe ends are inherited
+ * by fork and kept by exec, so together these build shell pipelines.
+ */
+extern int32_t ece391_pipe (int32_t fds[2]);
+extern int32_t ece391_dup2 (int32_t oldfd, int32_t newfd);
+
+/*
+ * The same calls made with sysenter instead of INT $0x80. Faster to get
+ * in and out of the kernel, and they behave the same otherwise.
+ */
+extern int32_t ece391_fast_execute (const uint8_t* command);
+extern int32_t ece391_fast_read (int32_t fd, void* buf, int32_t nbytes);
+extern int32_t ece391_fast_write (int32_t fd, const void* buf, int32_t nbytes);
+extern int32_t ece391_fast_open (const uint8_t* filename);
+extern int32_t ece391_fast_close (int32_t fd);
+extern int32_t ece391_fast_getargs (uint8_t* buf, int32_t nbytes);
+extern int32_t ece391_fast_vidmap (uint8_t** screen_start);
+extern int32_t ece391_fast_set_handler (int32_t signum, void* handler);
+extern int32_t ece391_fast_nice (int32_t value);
+extern int32_t ece391_fast_readv (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt);
+extern int32_t ece391_fast_writev (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt);
+extern int32_t ece391_fast_mmap (int32_t fd, void** addr);
+extern int32_t ece391_fast_munmap (void* addr);
 
 enum signums {
 	DIV_ZERO = 0,
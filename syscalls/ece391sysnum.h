@@ -11,5 +11,15 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_NICE    11
+#define SYS_READV   12
+#define SYS_WRITEV  13
+#define SYS_MMAP    14
+#define SYS_MUNMAP  15
+#define SYS_FORK    16
+#define SYS_EXEC    17
+#define SYS_WAIT    18
+#define SYS_PIPE    19
+#define SYS_DUP2    20
 
 #endif /* ECE391SYSNUM_H */
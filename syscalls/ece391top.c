@@ -0,0 +1,216 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Shows where CPU time goes, top-style, from the kernel's procstat file. Every second it prints
+ * each process with its share of the CPU over that second, total user/kernel time, how often it
+ * was switched out, and the syscall it makes most. "top N" refreshes N times (default 5).
+ */
+
+#define STAT_BUF_SIZE 65536
+#define LINE_SIZE 128
+#define MAX_PIDS 1024             /* the kernel's PID space */
+#define DEFAULT_REFRESHES 5
+#define RTC_HZ 2                /* RTC reads per second of refresh interval */
+#define NUM_SYSCALL_NAMES 21
+
+static uint8_t stat_buf[STAT_BUF_SIZE];
+static uint32_t prev_kc[MAX_PIDS];
+static uint8_t prev_seen[MAX_PIDS];
+
+static const char* syscall_names[NUM_SYSCALL_NAMES] = {
+    "", "halt", "execute", "read", "write", "open", "close",
+    "getargs", "vidmap", "set_handler", "sigreturn", "nice",
+    "readv", "writev", "mmap", "munmap", "fork", "exec", "wait",
+    "pipe", "dup2"
+};
+
+/* TSC in units of 1024 cycles, the same units procstat uses */
+static uint32_t rdtsc_kc (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return (hi << 22) | (lo >> 10);
+}
+
+/* Reads a decimal number at *p, skipping leading spaces, and moves *p past it */
+static uint32_t parse_num (uint8_t** p)
+{
+    uint32_t value = 0;
+
+    while (**p == ' ')
+        (*p)++;
+    while (**p >= '0' && **p <= '9') {
+        value = value * 10 + (**p - '0');
+        (*p)++;
+    }
+    return value;
+}
+
+/* Moves p to the start of the next line */
+static uint8_t* next_line (uint8_t* p)
+{
+    while (*p != '\0' && *p != '\n')
+        p++;
+    return (*p == '\n') ? p + 1 : p;
+}
+
+/* Appends s to line, right-aligned in width columns */
+static void put_col (uint8_t* line, const uint8_t* s, uint32_t width)
+{
+    uint32_t len = ece391_strlen (s);
+    uint8_t* end = line + ece391_strlen (line);
+
+    while (len < width) {
+        *end++ = ' ';
+        width--;
+    }
+    *end = '\0';
+    ece391_strcpy (end, s);
+}
+
+/* Appends value to line, right-aligned in width columns */
+static void put_num_col (uint8_t* line, uint32_t value, uint32_t width)
+{
+    uint8_t num[16];
+    put_col (line, ece391_itoa (value, num, 10), width);
+}
+
+static int32_t read_stats (void)
+{
+    int32_t fd, cnt, total = 0;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"procstat")))
+        return -1;
+    while (total < STAT_BUF_SIZE - 1 &&
+           0 < (cnt = ece391_read (fd, stat_buf + total, STAT_BUF_SIZE - 1 - total)))
+        total += cnt;
+    ece391_close (fd);
+    stat_buf[total] = '\0';
+    return 0;
+}
+
+static void show (uint32_t interval_kc, uint8_t have_prev)
+{
+    uint8_t line[LINE_SIZE];
+    uint8_t name[16];
+    uint8_t* p = stat_buf;
+    uint32_t khz_per_kc, pid, tty, nice, user_kc, kernel_kc, switches;
+    uint32_t num, calls, top_num, top_calls;
+    uint8_t state[2] = {0, 0};
+
+    /* "tsc_khz N", then the column names */
+    while (*p != '\0' && (*p < '0' || *p > '9'))
+        p++;
+    khz_per_kc = parse_num (&p) >> 10;      /* kc per millisecond */
+    if (khz_per_kc == 0)
+        khz_per_kc = 1;
+    p = next_line (next_line (p));
+
+    ece391_fdputs (1, (uint8_t*)"  PID TTY S NI  %CPU   USER_MS    SYS_MS SWITCHES TOP SYSCALL\n");
+    while (*p != '\0') {
+        pid = parse_num (&p);
+        tty = parse_num (&p);
+        while (*p == ' ')
+            p++;
+        state[0] = *p++;
+        nice = parse_num (&p);
+        user_kc = parse_num (&p);
+        kernel_kc = parse_num (&p);
+        switches = parse_num (&p);
+
+        /* number:calls:kc for each syscall, keep the one called most */
+        top_num = top_calls = 0;
+        while (*p == ' ') {
+            num = parse_num (&p);
+            p++;
+            calls = parse_num (&p);
+            p++;
+            (void)parse_num (&p);   /* kc */
+            if (calls > top_calls) {
+                top_num = num;
+                top_calls = calls;
+            }
+        }
+        p = next_line (p);
+
+        line[0] = '\0';
+        put_num_col (line, pid, 5);
+        put_num_col (line, tty, 4);
+        put_col (line, state, 2);
+        put_num_col (line, nice, 3);
+        if (have_prev && pid < MAX_PIDS && prev_seen[pid] && interval_kc != 0)
+            put_num_col (line, (user_kc + kernel_kc - prev_kc[pid]) * 100 / interval_kc, 6);
+        else
+            put_col (line, (uint8_t*)"-", 6);
+        put_num_col (line, user_kc / khz_per_kc, 10);
+        put_num_col (line, kernel_kc / khz_per_kc, 10);
+        put_num_col (line, switches, 9);
+        if (top_calls != 0) {
+            if (top_num < NUM_SYSCALL_NAMES)
+                ece391_strcpy (name, (uint8_t*)syscall_names[top_num]);
+            else
+                ece391_itoa (top_num, name, 10);
+            put_col (line, (uint8_t*)" ", 1);
+            put_col (line, name, 0);
+            put_col (line, (uint8_t*)" x", 0);
+            put_num_col (line, top_calls, 0);
+        }
+        put_col (line, (uint8_t*)"\n", 0);
+        ece391_fdputs (1, line);
+
+        if (pid < MAX_PIDS) {
+            prev_kc[pid] = user_kc + kernel_kc;
+            prev_seen[pid] = 2;     /* still around this round */
+        }
+    }
+
+    /* Forget PIDs that went away, a new process could reuse them */
+    for (pid = 0; pid < MAX_PIDS; pid++)
+        prev_seen[pid] = (prev_seen[pid] == 2);
+}
+
+int main ()
+{
+    uint8_t args[128];
+    int32_t rtc_fd, rate = RTC_HZ, garbage;
+    uint32_t refreshes = DEFAULT_REFRESHES, i, tick, now_kc, last_kc = 0;
+    uint8_t* p;
+
+    if (0 == ece391_getargs (args, sizeof (args))) {
+        p = args;
+        refreshes = parse_num (&p);
+        if (refreshes == 0 || *p != '\0') {
+            ece391_fdputs (1, (uint8_t*)"usage: top [refreshes]\n");
+            return 3;
+        }
+    }
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc")) ||
+        -1 == ece391_write (rtc_fd, &rate, 4)) {
+        ece391_fdputs (1, (uint8_t*)"top: can't open the RTC\n");
+        return 2;
+    }
+
+    for (i = 0; i < refreshes; i++) {
+        if (-1 == read_stats ()) {
+            ece391_fdputs (1, (uint8_t*)"top: can't open procstat\n");
+            ece391_close (rtc_fd);
+            return 2;
+        }
+        now_kc = rdtsc_kc ();
+        show (now_kc - last_kc, i != 0);
+        last_kc = now_kc;
+
+        if (i + 1 < refreshes) {
+            for (tick = 0; tick < RTC_HZ; tick++)
+                ece391_read (rtc_fd, &garbage, 4);
+            ece391_fdputs (1, (uint8_t*)"\n");
+        }
+    }
+
+    ece391_close (rtc_fd);
+    return 0;
+}